@@ -0,0 +1,56 @@
+#include "rebound.h"
+
+extern void bench_thread_counts(void (*measure)(u32_t thread_count));
+
+#define PUSHES_PER_THREAD 4000000
+#define PUSH_SIZE 32
+
+static void push_shared(void *arg) {
+    re_shared_arena_t *arena = arg;
+    for (u64_t i = 0; i < PUSHES_PER_THREAD; i++) {
+        u64_t *value = re_shared_arena_push(arena, PUSH_SIZE);
+        *value = i;
+    }
+}
+
+static void push_private(void *arg) {
+    (void) arg;
+    re_arena_t *arena = re_arena_create(PUSHES_PER_THREAD * PUSH_SIZE);
+    for (u64_t i = 0; i < PUSHES_PER_THREAD; i++) {
+        u64_t *value = re_arena_push(arena, PUSH_SIZE);
+        *value = i;
+    }
+    re_arena_destroy(&arena);
+}
+
+// Returns pushes per second across all threads.
+static f64_t run(re_thread_func_t func, void *arg, u32_t thread_count) {
+    re_thread_t threads[256];
+
+    f32_t start = re_os_get_time();
+    for (u32_t i = 0; i < thread_count; i++) {
+        threads[i] = re_thread_create(func, arg);
+    }
+    for (u32_t i = 0; i < thread_count; i++) {
+        re_thread_wait(threads[i]);
+        re_thread_destroy(threads[i]);
+    }
+    f32_t elapsed = re_os_get_time() - start;
+
+    return (f64_t) thread_count * PUSHES_PER_THREAD / elapsed;
+}
+
+static void measure(u32_t thread_count) {
+    re_shared_arena_t *shared = re_shared_arena_create((u64_t) thread_count * PUSHES_PER_THREAD * PUSH_SIZE);
+    f64_t shared_rate = run(push_shared, shared, thread_count);
+    re_shared_arena_destroy(&shared);
+
+    f64_t private_rate = run(push_private, NULL, thread_count);
+
+    re_log_info("%3u threads: shared arena %8.1f Mpush/s, per thread arenas %8.1f Mpush/s",
+            thread_count, shared_rate / 1e6, private_rate / 1e6);
+}
+
+void bench_arena(void) {
+    bench_thread_counts(measure);
+}
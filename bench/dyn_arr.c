@@ -0,0 +1,45 @@
+#include "rebound.h"
+
+#define PUSHES 100000000
+
+// Hand written growable array, the baseline re_dyn_arr_push has to match.
+static f32_t run_manual(void) {
+    f32_t start = re_os_get_time();
+
+    u32_t capacity = 8;
+    u32_t count = 0;
+    i32_t *arr = re_malloc(capacity * sizeof(i32_t));
+    for (i32_t i = 0; i < PUSHES; i++) {
+        if (count == capacity) {
+            capacity *= 2;
+            arr = re_realloc(arr, capacity * sizeof(i32_t));
+        }
+        arr[count++] = i;
+    }
+
+    f32_t elapsed = re_os_get_time() - start;
+    RE_ENSURE(arr[PUSHES - 1] == PUSHES - 1, "Pushes were optimized away.");
+    re_free(arr);
+    return elapsed;
+}
+
+static f32_t run_dyn_arr(void) {
+    f32_t start = re_os_get_time();
+
+    re_dyn_arr_t(i32_t) arr = NULL;
+    for (i32_t i = 0; i < PUSHES; i++) {
+        re_dyn_arr_push(arr, i);
+    }
+
+    f32_t elapsed = re_os_get_time() - start;
+    RE_ENSURE(arr[PUSHES - 1] == PUSHES - 1, "Pushes were optimized away.");
+    re_dyn_arr_free(arr);
+    return elapsed;
+}
+
+void bench_dyn_arr(void) {
+    f32_t manual = run_manual();
+    f32_t dyn_arr = run_dyn_arr();
+    re_log_info("%u i32 pushes: hand written %7.1f ms, re_dyn_arr_push %7.1f ms",
+            PUSHES, manual * 1e3f, dyn_arr * 1e3f);
+}
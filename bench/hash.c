@@ -0,0 +1,38 @@
+#include "rebound.h"
+
+#define BYTES_PER_RUN MB(256)
+
+// Returns hashed bytes per second.
+static f64_t run(re_hash_func_t func, const u8_t *data, u64_t key_size) {
+    u64_t iterations = BYTES_PER_RUN / key_size;
+    u64_t sink = 0;
+
+    f32_t start = re_os_get_time();
+    for (u64_t i = 0; i < iterations; i++) {
+        // Feed the previous result back in so the calls can't be hoisted.
+        sink += func(data + (sink & 63), key_size);
+    }
+    f32_t elapsed = re_os_get_time() - start;
+
+    RE_ASSERT(sink != 0, "Hash results were optimized away.");
+    return (f64_t) (iterations * key_size) / elapsed;
+}
+
+void bench_hash(void) {
+    static const u64_t key_sizes[] = {4, 8, 16, 32, 64, 256, 1024};
+
+    u8_t *data = re_malloc(1024 + 64);
+    for (u32_t i = 0; i < 1024 + 64; i++) {
+        data[i] = i * 31 + 7;
+    }
+
+    re_log_info("key size | fnv1a MB/s | wyhash MB/s | speedup");
+    for (u32_t i = 0; i < re_arr_len(key_sizes); i++) {
+        f64_t fnv = run(re_fvn1a_hash, data, key_sizes[i]);
+        f64_t wy = run(re_wyhash, data, key_sizes[i]);
+        re_log_info("%8llu | %10.0f | %11.0f | %6.2fx",
+                key_sizes[i], fnv / MB(1), wy / MB(1), wy / fnv);
+    }
+
+    re_free(data);
+}
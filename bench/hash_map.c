@@ -0,0 +1,334 @@
+#include "rebound.h"
+
+#define LOOKUPS 10000000
+
+typedef re_hash_map_t(u64_t, u64_t) bench_map_t;
+
+static u64_t next_key(u64_t *state) {
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return *state >> 1;
+}
+
+// Returns lookups per second. Missing keys have the top bit set, which
+// inserted keys never do.
+static f64_t run_lookups(bench_map_t map, u64_t count, b8_t hit) {
+    u64_t state = 1;
+    u64_t sink = 0;
+    f32_t start = re_os_get_time();
+    for (u64_t i = 0; i < LOOKUPS; i++) {
+        if (i % count == 0) {
+            state = 1;
+        }
+        u64_t key = next_key(&state);
+        if (!hit) {
+            key |= 1ull << 63;
+        }
+        sink += re_hash_map_get(map, key);
+    }
+    f32_t elapsed = re_os_get_time() - start;
+    RE_ASSERT(!hit || sink != 0, "Lookups were optimized away.");
+    return LOOKUPS / elapsed;
+}
+
+static void run(re_hash_map_engine_t engine, const char *name, u64_t count) {
+    bench_map_t map = NULL;
+    re_hash_map_init_desc(map, 0, 0, ((re_hash_map_desc_t) {.engine = engine}));
+
+    u64_t state = 1;
+    for (u64_t i = 0; i < count; i++) {
+        re_hash_map_set(map, next_key(&state), i + 1);
+    }
+
+    f64_t hit = run_lookups(map, count, true);
+    f64_t miss = run_lookups(map, count, false);
+    re_log_info("%-6s %9llu entries: hit %7.1f Mlookup/s, miss %7.1f Mlookup/s",
+            name, count, hit / 1e6, miss / 1e6);
+
+    re_hash_map_free(map);
+}
+
+static i32_t compare_latency(const void *a, const void *b) {
+    u32_t x = *(const u32_t *) a;
+    u32_t y = *(const u32_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void report_latency(const char *name, const char *op, u32_t *latencies, u32_t count) {
+    qsort(latencies, count, sizeof(u32_t), compare_latency);
+    re_log_info("%-10s %-6s p50 %6u ns, p99 %6u ns, p99.9 %7u ns, max %9u ns",
+            name, op,
+            latencies[count / 2],
+            latencies[(u64_t) count * 99 / 100],
+            latencies[(u64_t) count * 999 / 1000],
+            latencies[count - 1]);
+}
+
+// Cache eviction pattern: evict the oldest key and insert a new one.
+static void run_churn(re_hash_map_engine_t engine, const char *name) {
+    enum { LIVE = 1000000, CHURN = 4000000 };
+
+    bench_map_t map = NULL;
+    re_hash_map_init_desc(map, 0, 0, ((re_hash_map_desc_t) {.engine = engine}));
+
+    u64_t insert_state = 1;
+    u64_t evict_state = 1;
+    for (u64_t i = 0; i < LIVE; i++) {
+        re_hash_map_set(map, next_key(&insert_state), i);
+    }
+
+    u32_t *set_latencies = re_malloc(CHURN * sizeof(u32_t));
+    u32_t *remove_latencies = re_malloc(CHURN * sizeof(u32_t));
+    for (u32_t i = 0; i < CHURN; i++) {
+        u64_t start = re_os_get_time_ns();
+        re_hash_map_remove(map, next_key(&evict_state));
+        u64_t mid = re_os_get_time_ns();
+        re_hash_map_set(map, next_key(&insert_state), i);
+        u64_t end = re_os_get_time_ns();
+
+        remove_latencies[i] = mid - start;
+        set_latencies[i] = end - mid;
+    }
+
+    report_latency(name, "set", set_latencies, CHURN);
+    report_latency(name, "remove", remove_latencies, CHURN);
+
+    re_free(set_latencies);
+    re_free(remove_latencies);
+    re_hash_map_free(map);
+}
+
+// Worst case insert latency while growing to a large map.
+static void run_growth(u32_t flags, const char *name) {
+    enum { ENTRIES = 5000000 };
+
+    bench_map_t map = NULL;
+    re_hash_map_init_desc(map, 0, 0, ((re_hash_map_desc_t) {.flags = flags}));
+
+    u32_t *latencies = re_malloc(ENTRIES * sizeof(u32_t));
+    u64_t state = 1;
+    for (u32_t i = 0; i < ENTRIES; i++) {
+        u64_t key = next_key(&state);
+        u64_t start = re_os_get_time_ns();
+        re_hash_map_set(map, key, i);
+        latencies[i] = re_os_get_time_ns() - start;
+    }
+
+    report_latency(name, "set", latencies, ENTRIES);
+
+    re_free(latencies);
+    re_hash_map_free(map);
+}
+
+// Startup style bulk load of a fresh map.
+static void run_bulk_load(void) {
+    enum { ENTRIES = 1000000 };
+
+    u64_t *keys = re_malloc(ENTRIES * sizeof(u64_t));
+    u64_t *values = re_malloc(ENTRIES * sizeof(u64_t));
+    u64_t state = 1;
+    for (u32_t i = 0; i < ENTRIES; i++) {
+        keys[i] = next_key(&state);
+        values[i] = i;
+    }
+
+    bench_map_t map = NULL;
+    f32_t start = re_os_get_time();
+    for (u32_t i = 0; i < ENTRIES; i++) {
+        re_hash_map_set(map, keys[i], values[i]);
+    }
+    f32_t grow = re_os_get_time() - start;
+    re_hash_map_free(map);
+
+    start = re_os_get_time();
+    re_hash_map_init_capacity(map, ENTRIES);
+    for (u32_t i = 0; i < ENTRIES; i++) {
+        re_hash_map_set(map, keys[i], values[i]);
+    }
+    f32_t reserved = re_os_get_time() - start;
+    re_hash_map_free(map);
+
+    start = re_os_get_time();
+    re_hash_map_set_arr(map, keys, values, ENTRIES);
+    f32_t bulk = re_os_get_time() - start;
+    re_hash_map_free(map);
+
+    re_log_info("load %u entries: growing %.1f ms, reserved %.1f ms, set_arr %.1f ms",
+            ENTRIES, grow * 1e3f, reserved * 1e3f, bulk * 1e3f);
+
+    re_free(keys);
+    re_free(values);
+}
+
+// Small keys with big values, where interleaved buckets drag value bytes
+// through the cache on every probe.
+static void run_layout(u32_t flags, const char *name) {
+    enum { ENTRIES = 1000000 };
+    typedef struct {
+        u64_t data[16];
+    } big_value_t;
+
+    re_hash_map_t(u32_t, big_value_t) map = NULL;
+    re_hash_map_init_desc(map, 0, ((big_value_t) {0}), ((re_hash_map_desc_t) {.flags = flags}));
+
+    for (u32_t i = 0; i < ENTRIES; i++) {
+        big_value_t *value = re_hash_map_get_or_insert_ptr(map, i * 2);
+        value->data[0] = i;
+    }
+
+    u64_t sink = 0;
+    f32_t start = re_os_get_time();
+    for (u32_t i = 0; i < LOOKUPS; i++) {
+        big_value_t *value = re_hash_map_get_ptr(map, (i * 2654435761u) % ENTRIES * 2);
+        sink += value->data[0];
+    }
+    f32_t hit = re_os_get_time() - start;
+
+    start = re_os_get_time();
+    for (u32_t i = 0; i < LOOKUPS; i++) {
+        sink += re_hash_map_has(map, (i * 2654435761u) % ENTRIES * 2 + 1);
+    }
+    f32_t miss = re_os_get_time() - start;
+    RE_ASSERT(sink != 0, "Lookups were optimized away.");
+
+    re_log_info("%-4s 4 byte key, 128 byte value: hit %7.1f Mlookup/s, miss %7.1f Mlookup/s",
+            name, LOOKUPS / hit / 1e6, LOOKUPS / miss / 1e6);
+
+    re_hash_map_free(map);
+}
+
+// Cold start from a snapshot against building the map with re_hash_map_set.
+static void run_snapshot(void) {
+    enum { ENTRIES = 10000000, QUERIES = 1000000 };
+    const char *filepath = "/tmp/rebound_bench_hash_map.snapshot";
+
+    f32_t start = re_os_get_time();
+    re_hash_map_t(u64_t, u64_t) built = NULL;
+    for (u64_t i = 0; i < ENTRIES; i++) {
+        re_hash_map_set(built, i, i);
+    }
+    f32_t build = re_os_get_time() - start;
+    RE_ENSURE(re_hash_map_save(built, filepath), "Couldn't save the snapshot.");
+    re_hash_map_free(built);
+
+    // Too short for re_os_get_time.
+    u64_t load_start = re_os_get_time_ns();
+    re_hash_map_t(u64_t, u64_t) loaded = NULL;
+    RE_ENSURE(re_hash_map_load_default(loaded, filepath), "Couldn't load the snapshot.");
+    f32_t load = (re_os_get_time_ns() - load_start) * 1e-9f;
+
+    u64_t sink = 0;
+    start = re_os_get_time();
+    for (u32_t i = 0; i < QUERIES; i++) {
+        sink += re_hash_map_get(loaded, (i * 2654435761u) % ENTRIES);
+    }
+    f32_t query = re_os_get_time() - start;
+    RE_ASSERT(sink != 0, "Lookups were optimized away.");
+
+    re_log_info("%u entries: build %8.1f ms, snapshot load %7.1f us, first %u lookups %7.1f ms",
+            ENTRIES, build * 1e3f, load * 1e6f, QUERIES, query * 1e3f);
+
+    re_hash_map_free(loaded);
+    remove(filepath);
+}
+
+// Lookups through a frozen map against the map it was built from.
+static void run_frozen(u32_t count) {
+    re_hash_map_t(u64_t, u64_t) map = NULL;
+    for (u64_t i = 0; i < count; i++) {
+        re_hash_map_set(map, i * 2, i);
+    }
+
+    f32_t start = re_os_get_time();
+    re_frozen_map_t(u64_t, u64_t) frozen = NULL;
+    RE_ENSURE(re_hash_map_freeze(map, frozen), "Couldn't freeze the map.");
+    f32_t build = re_os_get_time() - start;
+
+    u64_t sink = 0;
+    start = re_os_get_time();
+    for (u32_t i = 0; i < LOOKUPS; i++) {
+        sink += re_hash_map_get(map, (i * 2654435761u) % count * 2);
+    }
+    f32_t map_hit = re_os_get_time() - start;
+
+    start = re_os_get_time();
+    for (u32_t i = 0; i < LOOKUPS; i++) {
+        sink += re_frozen_map_get(frozen, (i * 2654435761u) % count * 2);
+    }
+    f32_t frozen_hit = re_os_get_time() - start;
+    RE_ASSERT(sink != 0, "Lookups were optimized away.");
+
+    re_log_info("%8u entries: map %7.1f Mlookup/s %6.1f MB, frozen %7.1f Mlookup/s %6.1f MB, freeze %7.1f ms",
+            count, LOOKUPS / map_hit / 1e6, map->base.table.size / 1e6,
+            LOOKUPS / frozen_hit / 1e6, frozen->base.data_size / 1e6, build * 1e3f);
+
+    re_frozen_map_free(frozen);
+    re_hash_map_free(map);
+}
+
+// Iteration after growing to many entries and deleting most of them, where
+// the hash map still scans every bucket.
+static void run_iteration(void) {
+    enum { GROWN = 1000000, KEPT = 1000, ROUNDS = 1000 };
+
+    re_hash_map_t(u32_t, u32_t) hash_map = NULL;
+    re_index_map_t(u32_t, u32_t) index_map = NULL;
+    for (u32_t i = 0; i < GROWN; i++) {
+        re_hash_map_set(hash_map, i, i);
+        re_index_map_set(index_map, i, i);
+    }
+    for (u32_t i = KEPT; i < GROWN; i++) {
+        re_hash_map_remove(hash_map, i);
+        re_index_map_remove(index_map, i);
+    }
+
+    u64_t sink = 0;
+    f32_t start = re_os_get_time();
+    for (u32_t round = 0; round < ROUNDS; round++) {
+        for (u32_t i = re_hash_map_iter_get(hash_map); re_hash_map_iter_valid(i); i = re_hash_map_iter_next(hash_map, i)) {
+            sink += re_hash_map_get_index_value(hash_map, i);
+        }
+    }
+    f32_t sparse = re_os_get_time() - start;
+
+    start = re_os_get_time();
+    for (u32_t round = 0; round < ROUNDS; round++) {
+        for (u32_t i = 0; i < re_index_map_count(index_map); i++) {
+            sink += re_index_map_entries(index_map)[i].value;
+        }
+    }
+    f32_t dense = re_os_get_time() - start;
+    RE_ASSERT(sink != 0, "Iteration was optimized away.");
+
+    re_log_info("iterate %u of %u grown: hash map %8.3f ms, index map %8.3f ms",
+            KEPT, GROWN, sparse * 1e3f / ROUNDS, dense * 1e3f / ROUNDS);
+
+    re_hash_map_free(hash_map);
+    re_index_map_free(index_map);
+}
+
+void bench_hash_map(void) {
+    static const u64_t counts[] = {10000, 100000, 1000000, 10000000};
+    for (u32_t i = 0; i < re_arr_len(counts); i++) {
+        run(RE_HASH_MAP_ENGINE_LINEAR, "linear", counts[i]);
+        run(RE_HASH_MAP_ENGINE_SWISS, "swiss", counts[i]);
+        run(RE_HASH_MAP_ENGINE_ROBIN_HOOD, "robin", counts[i]);
+    }
+
+    run_churn(RE_HASH_MAP_ENGINE_LINEAR, "linear");
+    run_churn(RE_HASH_MAP_ENGINE_SWISS, "swiss");
+    run_churn(RE_HASH_MAP_ENGINE_ROBIN_HOOD, "robin hood");
+
+    run_growth(0, "rehash");
+    run_growth(RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE, "incremental");
+
+    run_bulk_load();
+
+    run_layout(0, "aos");
+    run_layout(RE_HASH_MAP_FLAG_SOA, "soa");
+
+    run_iteration();
+    run_snapshot();
+
+    run_frozen(100000);
+    run_frozen(10000000);
+}
@@ -0,0 +1,43 @@
+#include "rebound.h"
+
+extern void bench_arena(void);
+extern void bench_dyn_arr(void);
+extern void bench_hash(void);
+extern void bench_hash_map(void);
+extern void bench_shared_hash_map(void);
+
+// Calls measure with 1, 2, 4, ... threads up to the processor count, capped
+// at 256, then with the processor count itself unless it was already covered.
+void bench_thread_counts(void (*measure)(u32_t thread_count)) {
+    u32_t processor_count = re_clamp_max(re_os_get_processor_count(), 256);
+
+    u32_t thread_count = 1;
+    for (; thread_count <= processor_count; thread_count *= 2) {
+        measure(thread_count);
+    }
+    if (thread_count / 2 != processor_count) {
+        measure(processor_count);
+    }
+}
+
+i32_t main(void) {
+    re_init();
+
+    re_log_info("----- ARENA -----");
+    bench_arena();
+
+    re_log_info("----- DYNAMIC ARRAY -----");
+    bench_dyn_arr();
+
+    re_log_info("----- HASH -----");
+    bench_hash();
+
+    re_log_info("----- HASH MAP -----");
+    bench_hash_map();
+
+    re_log_info("----- SHARED HASH MAP -----");
+    bench_shared_hash_map();
+
+    re_terminate();
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "rebound.h"
+
+extern void bench_thread_counts(void (*measure)(u32_t thread_count));
+
+#define KEYS 1000000
+#define OPERATIONS_PER_THREAD 2000000
+
+typedef re_shared_hash_map_t(u64_t, u64_t) shared_map_t;
+typedef re_hash_map_t(u64_t, u64_t) locked_map_t;
+
+static shared_map_t shared_map = NULL;
+static locked_map_t locked_map = NULL;
+static re_mutex_t *locked_map_lock = NULL;
+
+// 90% lookups, 10% sets over a fixed key range.
+static void work_shared(void *arg) {
+    u64_t state = re_ptr_to_usize(arg);
+    u64_t sink = 0;
+    for (u32_t i = 0; i < OPERATIONS_PER_THREAD; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        u64_t key = (state >> 33) % KEYS;
+        if ((state >> 20) % 10 == 0) {
+            re_shared_hash_map_set(shared_map, key, i);
+        } else {
+            sink += re_shared_hash_map_get(shared_map, key);
+        }
+    }
+    (void) sink;
+}
+
+static void work_locked(void *arg) {
+    u64_t state = re_ptr_to_usize(arg);
+    u64_t sink = 0;
+    for (u32_t i = 0; i < OPERATIONS_PER_THREAD; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        u64_t key = (state >> 33) % KEYS;
+        re_mutex_lock(locked_map_lock);
+        if ((state >> 20) % 10 == 0) {
+            re_hash_map_set(locked_map, key, i);
+        } else {
+            sink += re_hash_map_get(locked_map, key);
+        }
+        re_mutex_unlock(locked_map_lock);
+    }
+    (void) sink;
+}
+
+// Returns operations per second across all threads.
+static f64_t run(re_thread_func_t func, u32_t thread_count) {
+    re_thread_t threads[256];
+
+    f32_t start = re_os_get_time();
+    for (u32_t i = 0; i < thread_count; i++) {
+        threads[i] = re_thread_create(func, (void *) (usize_t) (i + 1));
+    }
+    for (u32_t i = 0; i < thread_count; i++) {
+        re_thread_wait(threads[i]);
+        re_thread_destroy(threads[i]);
+    }
+    f32_t elapsed = re_os_get_time() - start;
+
+    return (f64_t) thread_count * OPERATIONS_PER_THREAD / elapsed;
+}
+
+static void measure(u32_t thread_count) {
+    f64_t shared_rate = run(work_shared, thread_count);
+    f64_t locked_rate = run(work_locked, thread_count);
+
+    re_log_info("%3u threads: sharded map %8.1f Mop/s, single lock map %8.1f Mop/s",
+            thread_count, shared_rate / 1e6, locked_rate / 1e6);
+}
+
+void bench_shared_hash_map(void) {
+    re_shared_hash_map_init(shared_map, 0, 0, ((re_hash_map_desc_t) {.capacity = KEYS}));
+    re_hash_map_init_capacity(locked_map, KEYS);
+    locked_map_lock = re_mutex_create();
+    for (u64_t key = 0; key < KEYS; key++) {
+        re_shared_hash_map_set(shared_map, key, key);
+        re_hash_map_set(locked_map, key, key);
+    }
+
+    bench_thread_counts(measure);
+
+    re_mutex_destroy(locked_map_lock);
+    re_hash_map_free(locked_map);
+    re_shared_hash_map_free(shared_map);
+}
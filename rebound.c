@@ -2,8 +2,11 @@
 
 #ifdef RE_OS_LINUX
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #endif
 
@@ -15,6 +18,10 @@
 #include <stdlib.h>
 #include <time.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 //  ____                   _
 // | __ )  __ _ ___  ___  | |    __ _ _   _  ___ _ __
 // |  _ \ / _` / __|/ _ \ | |   / _` | | | |/ _ \ '__|
@@ -27,21 +34,58 @@
 // Global state
 /*=========================*/
 
-/* typedef struct _rebound_state_t _rebound_state_t; */
-/* struct _rebound_state_t { */
-/* }; */
-/* static _rebound_state_t _re_state = {0}; */
+typedef struct _rebound_state_t _rebound_state_t;
+struct _rebound_state_t {
+    // Linked list of every live arena.
+    re_arena_t *arena_registry;
+    re_mutex_t *arena_registry_lock;
+
+    u32_t scratch_pool_size;
+    u64_t scratch_capacity;
+    u32_t scratch_flags;
+    b8_t scratch_recycle;
+    u64_t hash_seed;
+    // Scratch arenas handed over by re_arena_scratch_recycle.
+    re_dyn_arr_t(re_arena_t *) scratch_free;
+    re_mutex_t *scratch_free_lock;
+};
+static _rebound_state_t _re_state = {0};
 
 /*=========================*/
 // Initialization
 /*=========================*/
 
 void re_init(void) {
+    re_init_config((re_config_t) {0});
+}
+
+void re_init_config(re_config_t config) {
+    RE_ENSURE(config.scratch_pool_size <= RE_SCRATCH_POOL_MAX,
+            "Scratch pool size %u exceeds RE_SCRATCH_POOL_MAX (%u).",
+            config.scratch_pool_size, RE_SCRATCH_POOL_MAX);
+
     re_os_init();
+    _re_state.arena_registry_lock = re_mutex_create();
+
+    _re_state.scratch_pool_size = config.scratch_pool_size != 0 ? config.scratch_pool_size : 2;
+    _re_state.scratch_capacity = config.scratch_capacity != 0 ? config.scratch_capacity : GB(8);
+    _re_state.scratch_flags = config.scratch_flags | RE_SCRATCH_ARENA_FLAGS;
+    _re_state.scratch_recycle = config.scratch_recycle;
+    _re_state.scratch_free_lock = re_mutex_create();
+    _re_state.hash_seed = config.hash_seed;
 }
 
 void re_terminate(void) {
     _re_arena_scratch_destroy();
+    for (u32_t i = 0; i < re_dyn_arr_count(_re_state.scratch_free); i++) {
+        re_arena_destroy(&_re_state.scratch_free[i]);
+    }
+    re_dyn_arr_free(_re_state.scratch_free);
+    re_mutex_destroy(_re_state.scratch_free_lock);
+    _re_state.scratch_free_lock = NULL;
+
+    re_mutex_destroy(_re_state.arena_registry_lock);
+    _re_state.arena_registry_lock = NULL;
     re_os_terminate();
 }
 
@@ -55,6 +99,18 @@ void *re_malloc(usize_t size) {
     return ptr;
 }
 
+void *re_calloc(usize_t count, usize_t size) {
+#ifdef RE_CALLOC
+    void *ptr = RE_CALLOC(count, size);
+    RE_ENSURE(ptr != NULL, OUT_OF_MEMORY);
+#else
+    RE_ENSURE(size == 0 || count <= USIZE_MAX / size, OUT_OF_MEMORY);
+    void *ptr = re_malloc(count * size);
+    memset(ptr, 0, count * size);
+#endif
+    return ptr;
+}
+
 void *re_realloc(void *ptr, usize_t size) {
     void *new_ptr = RE_REALLOC(ptr, size);
     RE_ENSURE(new_ptr != NULL, OUT_OF_MEMORY);
@@ -63,6 +119,88 @@ void *re_realloc(void *ptr, usize_t size) {
 
 void re_free(void *ptr) { RE_FREE(ptr); }
 
+void *re_allocator_alloc_zeroed(re_allocator_t allocator, usize_t size) {
+    if (allocator.alloc_zeroed != NULL) {
+        return allocator.alloc_zeroed(size, allocator.ctx);
+    }
+    void *ptr = re_allocator_alloc(allocator, size);
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+static void *_re_heap_alloc(usize_t size, void *ctx) {
+    (void) ctx;
+    return re_malloc(size);
+}
+
+static void *_re_heap_alloc_zeroed(usize_t size, void *ctx) {
+    (void) ctx;
+    return re_calloc(1, size);
+}
+
+static void *_re_heap_resize(void *ptr, usize_t old_size, usize_t new_size, void *ctx) {
+    (void) old_size;
+    (void) ctx;
+    return re_realloc(ptr, new_size);
+}
+
+static void _re_heap_free(void *ptr, usize_t size, void *ctx) {
+    (void) size;
+    (void) ctx;
+    re_free(ptr);
+}
+
+re_allocator_t re_heap_allocator(void) {
+    return (re_allocator_t) {
+        .alloc = _re_heap_alloc,
+        .resize = _re_heap_resize,
+        .free = _re_heap_free,
+        .alloc_zeroed = _re_heap_alloc_zeroed,
+        .ctx = NULL
+    };
+}
+
+static void *_re_tracking_alloc(usize_t size, void *ctx) {
+    re_tracking_allocator_t *tracker = ctx;
+    tracker->alloc_count++;
+    tracker->bytes += size;
+    tracker->peak_bytes = re_max(tracker->peak_bytes, tracker->bytes);
+    return re_allocator_alloc(tracker->parent, size);
+}
+
+static void *_re_tracking_alloc_zeroed(usize_t size, void *ctx) {
+    re_tracking_allocator_t *tracker = ctx;
+    tracker->alloc_count++;
+    tracker->bytes += size;
+    tracker->peak_bytes = re_max(tracker->peak_bytes, tracker->bytes);
+    return re_allocator_alloc_zeroed(tracker->parent, size);
+}
+
+static void *_re_tracking_resize(void *ptr, usize_t old_size, usize_t new_size, void *ctx) {
+    re_tracking_allocator_t *tracker = ctx;
+    tracker->resize_count++;
+    tracker->bytes += new_size - old_size;
+    tracker->peak_bytes = re_max(tracker->peak_bytes, tracker->bytes);
+    return re_allocator_resize(tracker->parent, ptr, old_size, new_size);
+}
+
+static void _re_tracking_free(void *ptr, usize_t size, void *ctx) {
+    re_tracking_allocator_t *tracker = ctx;
+    tracker->free_count++;
+    tracker->bytes -= size;
+    re_allocator_free(tracker->parent, ptr, size);
+}
+
+re_allocator_t re_tracking_allocator(re_tracking_allocator_t *tracker) {
+    return (re_allocator_t) {
+        .alloc = _re_tracking_alloc,
+        .resize = _re_tracking_resize,
+        .free = _re_tracking_free,
+        .alloc_zeroed = _re_tracking_alloc_zeroed,
+        .ctx = tracker
+    };
+}
+
 /*=========================*/
 // Arena
 /*=========================*/
@@ -71,35 +209,230 @@ struct re_arena_t {
     u64_t capacity;
     u64_t position;
     u64_t commited;
+    u64_t commit_size;
+    u64_t retain_size;
+    u32_t flags;
     ptr_t pool;
+
+    // Block currently pushed to, the arena itself unless it's chained.
+    re_arena_t *current;
+    // Previous block in the chain.
+    re_arena_t *prev_block;
+    // Empty block kept around after popping so that pushing and popping
+    // around a block boundary doesn't reserve and release memory every time.
+    re_arena_t *spare_block;
+    // Position of this block's first byte within the chain.
+    u64_t base_position;
+
+    // Registry links.
+    re_arena_t *next;
+    re_arena_t *prev;
+    re_arena_stats_t stats;
 };
 
+// Rounds 'value' up to the next multiple of the block commit size.
+static u64_t _re_arena_commit_round(const re_arena_t *block, u64_t value) {
+    u64_t rounded = (value + block->commit_size - 1) / block->commit_size * block->commit_size;
+    return re_clamp_max(rounded, block->capacity);
+}
+
+// Decommits everything past the chunk holding the block position plus one
+// spare chunk. The spare chunk keeps push/pop cycles around a chunk boundary
+// from thrashing between commit and decommit.
+static void _re_arena_decommit_excess(re_arena_t *arena, re_arena_t *block) {
+    u64_t keep = _re_arena_commit_round(block, block->position + block->commit_size);
+    keep = re_max(keep, block->retain_size);
+    if (keep < block->commited) {
+        if (arena->flags & RE_ARENA_FLAG_STATS) {
+            arena->stats.decommit_count++;
+        }
+        if (block->flags & RE_ARENA_FLAG_LAZY_DECOMMIT) {
+            re_os_mem_decommit_lazy((ptr_t) block + keep, block->commited - keep);
+        } else {
+            re_os_mem_decommit((ptr_t) block + keep, block->commited - keep);
+        }
+        block->commited = keep;
+    }
+}
+
+// Reserves a block able to hold 'capacity' bytes past its header.
+static re_arena_t *_re_arena_block_create(u64_t capacity, u64_t commit_size, u32_t flags) {
+    u64_t page_size = re_os_get_page_size();
+    u64_t actual_capacity = ((sizeof(re_arena_t) + capacity) + page_size - 1) & ~(page_size - 1);
+    commit_size = (commit_size + page_size - 1) & ~(page_size - 1);
+
+    re_arena_t *block = NULL;
+    if (flags & (RE_ARENA_FLAG_HUGE_PAGES | RE_ARENA_FLAG_HUGE_PAGES_EXPLICIT)) {
+        // Huge pages can only back whole, aligned huge page ranges
+        // so both the reservation and commits must be multiples of them.
+        u64_t huge_page_size = re_os_get_huge_page_size();
+        actual_capacity = re_align_up(actual_capacity, huge_page_size);
+        commit_size = re_align_up(commit_size, huge_page_size);
+
+        if (flags & RE_ARENA_FLAG_HUGE_PAGES_EXPLICIT) {
+            block = re_os_mem_reserve_huge(actual_capacity, RE_OS_HUGE_PAGES_EXPLICIT);
+        }
+        if (block == NULL) {
+            block = re_os_mem_reserve_huge(actual_capacity, RE_OS_HUGE_PAGES_TRANSPARENT);
+        }
+    } else {
+        block = re_os_mem_reserve(actual_capacity);
+    }
+    RE_ENSURE(block != NULL, OUT_OF_MEMORY);
+
+    u64_t initial_commit = re_min(commit_size, actual_capacity);
+    re_os_mem_commit(block, initial_commit);
+
+    *block = (re_arena_t) {
+        .capacity = actual_capacity,
+        .position = sizeof(re_arena_t),
+        .commited = initial_commit,
+        .commit_size = commit_size,
+        .flags = flags,
+        .pool = (ptr_t) block + sizeof(re_arena_t),
+        .current = block
+    };
+
+    return block;
+}
+
+// Links a block able to hold 'size' bytes to the end of the chain.
+static re_arena_t *_re_arena_chain_block(re_arena_t *arena, u64_t size) {
+    re_arena_t *block = arena->spare_block;
+    if (block != NULL && block->capacity - sizeof(re_arena_t) >= size) {
+        arena->spare_block = NULL;
+    } else {
+        u64_t capacity = re_max(arena->capacity - sizeof(re_arena_t), size);
+        block = _re_arena_block_create(capacity, arena->commit_size, arena->flags);
+        if (arena->flags & RE_ARENA_FLAG_STATS) {
+            arena->stats.commit_count++;
+        }
+    }
+
+    block->base_position = arena->current->base_position + arena->current->capacity;
+    block->prev_block = arena->current;
+    arena->current = block;
+
+    return block;
+}
+
+// Unlinks the last block of the chain, keeping it as the spare block if
+// there isn't one already.
+static void _re_arena_unchain_block(re_arena_t *arena) {
+    re_arena_t *block = arena->current;
+    arena->current = block->prev_block;
+
+    if (arena->spare_block == NULL) {
+        block->position = sizeof(re_arena_t);
+        block->prev_block = NULL;
+        _re_arena_decommit_excess(arena, block);
+        arena->spare_block = block;
+    } else {
+        re_os_mem_release(block, block->capacity);
+    }
+}
+
 re_arena_t *re_arena_create(u64_t capacity) {
-    u64_t actual_capacity = ((sizeof(re_arena_t) + capacity) + (u64_t) re_os_get_page_size() - 1) & (~(u64_t) re_os_get_page_size() - 1);
-    re_arena_t *arena = re_os_mem_reserve(actual_capacity);
-    re_os_mem_commit(arena, re_os_get_page_size());
+    return re_arena_create_desc((re_arena_desc_t) {
+            .capacity = capacity
+        });
+}
 
-    arena->capacity = actual_capacity;
-    arena->position = sizeof(re_arena_t);
-    arena->commited = re_os_get_page_size();
-    arena->pool = (ptr_t) arena + sizeof(re_arena_t);
+static void _re_arena_registry_lock(void) {
+    if (_re_state.arena_registry_lock != NULL) {
+        re_mutex_lock(_re_state.arena_registry_lock);
+    }
+}
+
+static void _re_arena_registry_unlock(void) {
+    if (_re_state.arena_registry_lock != NULL) {
+        re_mutex_unlock(_re_state.arena_registry_lock);
+    }
+}
+
+re_arena_t *re_arena_create_desc(re_arena_desc_t desc) {
+#ifdef RE_ARENA_STATS
+    desc.flags |= RE_ARENA_FLAG_STATS;
+#endif
+
+    u64_t commit_size = desc.commit_size != 0 ? desc.commit_size : RE_ARENA_DEFAULT_COMMIT_SIZE;
+    re_arena_t *arena = _re_arena_block_create(desc.capacity, commit_size, desc.flags);
+    arena->retain_size = _re_arena_commit_round(arena, desc.retain_size);
+    arena->stats = (re_arena_stats_t) {
+        .name = desc.name != NULL ? desc.name : "unnamed",
+        .peak_position = arena->position,
+        .peak_commited = arena->commited,
+        .commit_count = 1
+    };
+
+    _re_arena_registry_lock();
+    arena->prev = NULL;
+    arena->next = _re_state.arena_registry;
+    if (arena->next != NULL) {
+        arena->next->prev = arena;
+    }
+    _re_state.arena_registry = arena;
+    _re_arena_registry_unlock();
 
     return arena;
 }
 
 void re_arena_destroy(re_arena_t **arena) {
+    _re_arena_registry_lock();
+    if ((*arena)->prev != NULL) {
+        (*arena)->prev->next = (*arena)->next;
+    } else {
+        _re_state.arena_registry = (*arena)->next;
+    }
+    if ((*arena)->next != NULL) {
+        (*arena)->next->prev = (*arena)->prev;
+    }
+    _re_arena_registry_unlock();
+
+    while ((*arena)->current != *arena) {
+        re_arena_t *block = (*arena)->current;
+        (*arena)->current = block->prev_block;
+        re_os_mem_release(block, block->capacity);
+    }
+    if ((*arena)->spare_block != NULL) {
+        re_os_mem_release((*arena)->spare_block, (*arena)->spare_block->capacity);
+    }
+
     re_os_mem_release(*arena, (*arena)->capacity);
     *arena = NULL;
 }
 
 void *re_arena_push(re_arena_t *arena, u64_t size) {
-    while (arena->position + size >= arena->commited) {
-        re_os_mem_commit((ptr_t) arena + arena->commited, re_os_get_page_size());
-        arena->commited += re_os_get_page_size();
+    re_arena_t *block = arena->current;
+    u64_t end = block->position + size;
+    if (end > block->capacity) {
+        RE_ENSURE(arena->flags & RE_ARENA_FLAG_CHAINED,
+                "Arena out of memory, pushing %llu bytes exceeds the capacity of %llu bytes.",
+                size, arena->capacity);
+        block = _re_arena_chain_block(arena, size);
+        end = block->position + size;
+    }
+
+    if (end > block->commited) {
+        // Commit the whole shortfall in a single call.
+        u64_t commit_end = _re_arena_commit_round(block, end);
+        re_os_mem_commit((ptr_t) block + block->commited, commit_end - block->commited);
+        block->commited = commit_end;
+
+        if (arena->flags & RE_ARENA_FLAG_STATS) {
+            arena->stats.commit_count++;
+            arena->stats.peak_commited = re_max(arena->stats.peak_commited, block->base_position + commit_end);
+        }
+    }
+
+    if (arena->flags & RE_ARENA_FLAG_STATS) {
+        arena->stats.push_count++;
+        arena->stats.push_bytes += size;
+        arena->stats.peak_position = re_max(arena->stats.peak_position, block->base_position + end);
     }
 
-    void *result = (ptr_t) arena + arena->position;
-    arena->position += size;
+    void *result = (ptr_t) block + block->position;
+    block->position = end;
     return result;
 }
 
@@ -113,75 +446,402 @@ void *re_arena_push_zero(re_arena_t *arena, u64_t size) {
     return result;
 }
 
+void *re_arena_push_aligned(re_arena_t *arena, u64_t size, u64_t alignment) {
+    RE_ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0, "Arena alignment must be a power of two.");
+
+    re_arena_t *block = arena->current;
+    u64_t address = re_ptr_to_usize(block) + block->position;
+    u64_t padding = re_align_up(address, alignment) - address;
+
+    // Padding depends on the block, so move to the next one before calculating it.
+    if (block->position + padding + size > block->capacity && (arena->flags & RE_ARENA_FLAG_CHAINED)) {
+        block = _re_arena_chain_block(arena, size + alignment);
+        address = re_ptr_to_usize(block) + block->position;
+        padding = re_align_up(address, alignment) - address;
+    }
+
+    return (ptr_t) re_arena_push(arena, padding + size) + padding;
+}
+
+void *re_arena_push_aligned_zero(re_arena_t *arena, u64_t size, u64_t alignment) {
+    ptr_t result = re_arena_push_aligned(arena, size, alignment);
+    memset(result, 0, size);
+    return result;
+}
+
 void re_arena_pop(re_arena_t *arena, u64_t size) {
-    while (arena->position <= arena->commited - re_os_get_page_size()) {
-        arena->commited -= re_os_get_page_size();
-        re_os_mem_decommit((ptr_t) arena + arena->commited, re_os_get_page_size());
+    while (true) {
+        re_arena_t *block = arena->current;
+        u64_t amount = re_min(size, block->position - sizeof(re_arena_t));
+        block->position -= amount;
+        size -= amount;
+
+        // Free trailing blocks once they're emptied.
+        if (block == arena || block->position > sizeof(re_arena_t)) {
+            break;
+        }
+        _re_arena_unchain_block(arena);
     }
-    arena->position -= size;
+    RE_ASSERT(size == 0, "Popping more than was pushed to the arena.");
+
+    _re_arena_decommit_excess(arena, arena->current);
 }
 
 void re_arena_clear(re_arena_t *arena) {
-    re_os_mem_decommit((ptr_t) arena + re_os_get_page_size(), arena->commited - re_os_get_page_size());
-    arena->commited = re_os_get_page_size();
+    while (arena->current != arena) {
+        _re_arena_unchain_block(arena);
+    }
     arena->position = sizeof(re_arena_t);
+    _re_arena_decommit_excess(arena, arena);
+}
+
+// Alignment of arena allocator allocations, suitable for any type.
+#define _RE_ARENA_ALLOCATOR_ALIGNMENT 16
+
+static void *_re_arena_allocator_alloc(usize_t size, void *ctx) {
+    return re_arena_push_aligned(ctx, size, _RE_ARENA_ALLOCATOR_ALIGNMENT);
+}
+
+static void *_re_arena_allocator_resize(void *ptr, usize_t old_size, usize_t new_size, void *ctx) {
+    re_arena_t *arena = ctx;
+    re_arena_t *block = arena->current;
+
+    // The last allocation can grow and shrink in place.
+    if ((ptr_t) ptr + old_size == (ptr_t) block + block->position) {
+        if (new_size <= old_size) {
+            re_arena_pop(arena, old_size - new_size);
+            return ptr;
+        }
+        if (block->position + (new_size - old_size) <= block->capacity) {
+            re_arena_push(arena, new_size - old_size);
+            return ptr;
+        }
+    }
+
+    if (new_size <= old_size) {
+        return ptr;
+    }
+
+    void *result = re_arena_push_aligned(arena, new_size, _RE_ARENA_ALLOCATOR_ALIGNMENT);
+    memcpy(result, ptr, old_size);
+    return result;
+}
+
+static void _re_arena_allocator_free(void *ptr, usize_t size, void *ctx) {
+    re_arena_t *arena = ctx;
+    re_arena_t *block = arena->current;
+    if ((ptr_t) ptr + size == (ptr_t) block + block->position) {
+        re_arena_pop(arena, size);
+    }
+}
+
+re_allocator_t re_arena_allocator(re_arena_t *arena) {
+    return (re_allocator_t) {
+        .alloc = _re_arena_allocator_alloc,
+        .resize = _re_arena_allocator_resize,
+        .free = _re_arena_allocator_free,
+        .ctx = arena
+    };
 }
 
 u64_t re_arena_get_pos(re_arena_t *arena) {
-    return arena->position;
+    return arena->current->base_position + arena->current->position;
 }
 
 void *re_arena_get_index(u64_t index, re_arena_t *arena) {
-    return (ptr_t) arena + index;
+    re_arena_t *block = arena->current;
+    while (block->base_position > index) {
+        block = block->prev_block;
+    }
+    return (ptr_t) block + (index - block->base_position);
+}
+
+re_arena_stats_t re_arena_get_stats(re_arena_t *arena) {
+    re_arena_stats_t stats = arena->stats;
+    stats.capacity = arena->current->base_position + arena->current->capacity;
+    stats.position = re_arena_get_pos(arena);
+    stats.commited = 0;
+    for (re_arena_t *block = arena->current; block != NULL; block = block->prev_block) {
+        stats.commited += block->commited;
+    }
+    return stats;
+}
+
+void re_arena_registry_iter(re_arena_stats_callback_t callback, void *user_data) {
+    _re_arena_registry_lock();
+    for (re_arena_t *arena = _re_state.arena_registry; arena != NULL; arena = arena->next) {
+        re_arena_stats_t stats = re_arena_get_stats(arena);
+        callback(&stats, user_data);
+    }
+    _re_arena_registry_unlock();
+}
+
+static void _re_arena_registry_dump_callback(const re_arena_stats_t *stats, void *user_data) {
+    fprintf(user_data,
+            "%-16s capacity %llu, position %llu (peak %llu), commited %llu (peak %llu), "
+            "%llu commits, %llu decommits, %llu pushes totaling %llu bytes\n",
+            stats->name, stats->capacity,
+            stats->position, stats->peak_position,
+            stats->commited, stats->peak_commited,
+            stats->commit_count, stats->decommit_count,
+            stats->push_count, stats->push_bytes);
+}
+
+void re_arena_registry_dump(FILE *fp) {
+    re_arena_registry_iter(_re_arena_registry_dump_callback, fp);
+    fflush(fp);
+}
+
+u64_t re_arena_get_huge_page_bytes(re_arena_t *arena) {
+    u64_t result = 0;
+    for (re_arena_t *block = arena->current; block != NULL; block = block->prev_block) {
+        result += re_os_mem_huge_page_bytes(block, block->commited);
+    }
+    return result;
 }
 
 re_arena_temp_t re_arena_temp_start(re_arena_t *arena) {
     return (re_arena_temp_t) {
         .arena = arena,
-        .position = arena->position
+        .position = re_arena_get_pos(arena)
     };
 }
 
 void re_arena_temp_end(re_arena_temp_t *arena) {
-    arena->arena->position = arena->position;
+    re_arena_t *head = arena->arena;
+    // A position at the very end of a full block equals the base of the next
+    // one, which has to go too or the next push would land on its header.
+    while (head->current->base_position >= arena->position) {
+        _re_arena_unchain_block(head);
+    }
+    head->current->position = arena->position - head->current->base_position;
+}
+
+/*=========================*/
+// Shared arena
+/*=========================*/
+
+struct re_shared_arena_t {
+    u64_t capacity;
+    u64_t commit_size;
+    u64_t retain_size;
+    u32_t flags;
+
+    // Each on its own cache line, pushing threads hammer 'position' while
+    // 'commited' is read on every push.
+    __attribute__((aligned(64))) u64_t position;
+    // End of the range some thread has taken responsibility for committing.
+    __attribute__((aligned(64))) u64_t commit_claimed;
+    // End of the range committed and safe to use.
+    u64_t commited;
+};
+
+// Makes sure everything up to 'end' is committed.
+static void _re_shared_arena_ensure_commited(re_shared_arena_t *arena, u64_t end) {
+    if (end <= __atomic_load_n(&arena->commited, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    u64_t claimed = __atomic_load_n(&arena->commit_claimed, __ATOMIC_RELAXED);
+    while (claimed < end) {
+        u64_t target = (end + arena->commit_size - 1) / arena->commit_size * arena->commit_size;
+        target = re_clamp_max(target, arena->capacity);
+        if (__atomic_compare_exchange_n(&arena->commit_claimed, &claimed, target,
+                    true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            re_os_mem_commit((ptr_t) arena + claimed, target - claimed);
+
+            // Publish in order, earlier claims must become visible first.
+            while (__atomic_load_n(&arena->commited, __ATOMIC_ACQUIRE) != claimed) {
+                re_thread_yield();
+            }
+            __atomic_store_n(&arena->commited, target, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+
+    // Another thread claimed the range, wait for it to be committed.
+    while (__atomic_load_n(&arena->commited, __ATOMIC_ACQUIRE) < end) {
+        re_thread_yield();
+    }
+}
+
+re_shared_arena_t *re_shared_arena_create(u64_t capacity) {
+    return re_shared_arena_create_desc((re_arena_desc_t) {
+            .capacity = capacity
+        });
+}
+
+re_shared_arena_t *re_shared_arena_create_desc(re_arena_desc_t desc) {
+    RE_ASSERT(!(desc.flags & RE_ARENA_FLAG_CHAINED), "Shared arenas can't be chained.");
+
+    u64_t page_size = re_os_get_page_size();
+    u64_t actual_capacity = ((sizeof(re_shared_arena_t) + desc.capacity) + page_size - 1) & ~(page_size - 1);
+    u64_t commit_size = desc.commit_size != 0 ? desc.commit_size : RE_ARENA_DEFAULT_COMMIT_SIZE;
+    commit_size = (commit_size + page_size - 1) & ~(page_size - 1);
+
+    re_shared_arena_t *arena = NULL;
+    if (desc.flags & (RE_ARENA_FLAG_HUGE_PAGES | RE_ARENA_FLAG_HUGE_PAGES_EXPLICIT)) {
+        u64_t huge_page_size = re_os_get_huge_page_size();
+        actual_capacity = re_align_up(actual_capacity, huge_page_size);
+        commit_size = re_align_up(commit_size, huge_page_size);
+
+        if (desc.flags & RE_ARENA_FLAG_HUGE_PAGES_EXPLICIT) {
+            arena = re_os_mem_reserve_huge(actual_capacity, RE_OS_HUGE_PAGES_EXPLICIT);
+        }
+        if (arena == NULL) {
+            arena = re_os_mem_reserve_huge(actual_capacity, RE_OS_HUGE_PAGES_TRANSPARENT);
+        }
+    } else {
+        arena = re_os_mem_reserve(actual_capacity);
+    }
+    RE_ENSURE(arena != NULL, OUT_OF_MEMORY);
+
+    u64_t initial_commit = re_min(commit_size, actual_capacity);
+    initial_commit = re_max(initial_commit, re_align_up(sizeof(re_shared_arena_t), page_size));
+    re_os_mem_commit(arena, initial_commit);
+
+    *arena = (re_shared_arena_t) {
+        .capacity = actual_capacity,
+        .commit_size = commit_size,
+        .flags = desc.flags,
+        .position = sizeof(re_shared_arena_t),
+        .commit_claimed = initial_commit,
+        .commited = initial_commit
+    };
+    arena->retain_size = (desc.retain_size + commit_size - 1) / commit_size * commit_size;
+
+    return arena;
+}
+
+void re_shared_arena_destroy(re_shared_arena_t **arena) {
+    re_os_mem_release(*arena, (*arena)->capacity);
+    *arena = NULL;
+}
+
+void *re_shared_arena_push(re_shared_arena_t *arena, u64_t size) {
+    u64_t start = __atomic_fetch_add(&arena->position, size, __ATOMIC_RELAXED);
+    u64_t end = start + size;
+    RE_ENSURE(end <= arena->capacity,
+            "Shared arena out of memory, pushing %llu bytes exceeds the capacity of %llu bytes.",
+            size, arena->capacity);
+
+    _re_shared_arena_ensure_commited(arena, end);
+    return (ptr_t) arena + start;
+}
+
+void *re_shared_arena_push_zero(re_shared_arena_t *arena, u64_t size) {
+    ptr_t result = re_shared_arena_push(arena, size);
+    memset(result, 0, size);
+    return result;
+}
+
+void *re_shared_arena_push_aligned(re_shared_arena_t *arena, u64_t size, u64_t alignment) {
+    RE_ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0, "Arena alignment must be a power of two.");
+
+    // Padding depends on the position, so a plain fetch-add won't do.
+    u64_t start = __atomic_load_n(&arena->position, __ATOMIC_RELAXED);
+    u64_t aligned;
+    do {
+        aligned = re_align_up(start, alignment);
+    } while (!__atomic_compare_exchange_n(&arena->position, &start, aligned + size,
+                true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    u64_t end = aligned + size;
+    RE_ENSURE(end <= arena->capacity,
+            "Shared arena out of memory, pushing %llu bytes exceeds the capacity of %llu bytes.",
+            size, arena->capacity);
+
+    _re_shared_arena_ensure_commited(arena, end);
+    return (ptr_t) arena + aligned;
+}
+
+void re_shared_arena_clear(re_shared_arena_t *arena) {
+    arena->position = sizeof(re_shared_arena_t);
+
+    // Same hysteresis as regular arenas, keep the first chunk plus a spare one.
+    u64_t keep = (arena->position + 2 * arena->commit_size - 1) / arena->commit_size * arena->commit_size;
+    keep = re_max(keep, arena->retain_size);
+    keep = re_clamp_max(keep, arena->capacity);
+    if (keep < arena->commited) {
+        if (arena->flags & RE_ARENA_FLAG_LAZY_DECOMMIT) {
+            re_os_mem_decommit_lazy((ptr_t) arena + keep, arena->commited - keep);
+        } else {
+            re_os_mem_decommit((ptr_t) arena + keep, arena->commited - keep);
+        }
+        arena->commited = keep;
+        arena->commit_claimed = keep;
+    }
+}
+
+u64_t re_shared_arena_get_pos(re_shared_arena_t *arena) {
+    return __atomic_load_n(&arena->position, __ATOMIC_RELAXED);
 }
 
 /*=========================*/
 // Scratch arena
 /*=========================*/
 
-#define RE_SCRATCH_POOL_SIZE 2
+RE_THREAD_LOCAL re_arena_t *_re_scratch_pool[RE_SCRATCH_POOL_MAX] = {0};
+
+// Takes a recycled scratch arena if there is one, otherwise reserves a new one.
+static re_arena_t *_re_arena_scratch_acquire(void) {
+    re_arena_t *arena = NULL;
+
+    re_mutex_lock(_re_state.scratch_free_lock);
+    if (re_dyn_arr_count(_re_state.scratch_free) > 0) {
+        arena = re_dyn_arr_pop(_re_state.scratch_free);
+    }
+    re_mutex_unlock(_re_state.scratch_free_lock);
+
+    if (arena == NULL) {
+        arena = re_arena_create_desc((re_arena_desc_t) {
+                .capacity = _re_state.scratch_capacity,
+                .flags = _re_state.scratch_flags,
+                .name = "scratch"
+            });
+    }
 
-RE_THREAD_LOCAL re_arena_t *_re_scratch_pool[RE_SCRATCH_POOL_SIZE] = {0};
+    return arena;
+}
 
 re_arena_temp_t re_arena_scratch_get(re_arena_t **conflicts, u32_t conflict_count) {
-    if (_re_scratch_pool[0] == NULL) {
-        for (u32_t i = 0; i < RE_SCRATCH_POOL_SIZE; i++) {
-            _re_scratch_pool[i] = re_arena_create(GB(8));
+    for (u32_t i = 0; i < _re_state.scratch_pool_size; i++) {
+        if (_re_scratch_pool[i] == NULL) {
+            // Not created yet, so it can't be conflicting.
+            _re_scratch_pool[i] = _re_arena_scratch_acquire();
+            return re_arena_temp_start(_re_scratch_pool[i]);
         }
-    }
 
-    re_arena_temp_t result = {0};
-    for (u32_t i = 0; i < RE_SCRATCH_POOL_SIZE; i++) {
         b8_t conflict = false;
         for (u32_t j = 0; j < conflict_count; j++) {
-            if (conflicts[i] == _re_scratch_pool[i]) {
+            if (conflicts[j] == _re_scratch_pool[i]) {
                 conflict = true;
                 break;
             }
         }
         if (!conflict) {
-            result = re_arena_temp_start(_re_scratch_pool[i]);
-            break;
+            return re_arena_temp_start(_re_scratch_pool[i]);
         }
     }
 
-    return result;
+    RE_ABORT("All %u scratch arenas conflict, raise the scratch pool size.", _re_state.scratch_pool_size);
+}
+
+void re_arena_scratch_recycle(void) {
+    re_mutex_lock(_re_state.scratch_free_lock);
+    for (u32_t i = 0; i < RE_SCRATCH_POOL_MAX; i++) {
+        if (_re_scratch_pool[i] != NULL) {
+            re_arena_clear(_re_scratch_pool[i]);
+            re_dyn_arr_push(_re_state.scratch_free, _re_scratch_pool[i]);
+            _re_scratch_pool[i] = NULL;
+        }
+    }
+    re_mutex_unlock(_re_state.scratch_free_lock);
 }
 
 void _re_arena_scratch_destroy(void) {
-    if (_re_scratch_pool[0] != NULL) {
-        for (u32_t i = 0; i < RE_SCRATCH_POOL_SIZE; i++) {
+    for (u32_t i = 0; i < RE_SCRATCH_POOL_MAX; i++) {
+        if (_re_scratch_pool[i] != NULL) {
             re_arena_destroy(&_re_scratch_pool[i]);
         }
     }
@@ -200,6 +860,82 @@ u64_t re_fvn1a_hash(const void *data, u64_t size) {
     return hash;
 }
 
+static const u64_t _re_wyhash_secret[4] = {
+    0xa0761d6478bd642full,
+    0xe7037ed1a0b428dbull,
+    0x8ebc6af09c88c6e3ull,
+    0x589965cc75374cc3ull
+};
+
+static inline u64_t _re_wyhash_mix(u64_t a, u64_t b) {
+    __uint128_t r = (__uint128_t) a * b;
+    return (u64_t) r ^ (u64_t) (r >> 64);
+}
+
+static inline u64_t _re_wyhash_read8(const u8_t *p) {
+    u64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline u64_t _re_wyhash_read4(const u8_t *p) {
+    u32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+u64_t re_wyhash(const void *data, u64_t size) {
+    return re_wyhash_seeded(data, size, _re_state.hash_seed);
+}
+
+u64_t re_wyhash_seeded(const void *data, u64_t size, u64_t seed) {
+    const u64_t *secret = _re_wyhash_secret;
+    const u8_t *p = data;
+    u64_t a, b;
+
+    seed ^= _re_wyhash_mix(seed ^ secret[0], secret[1]);
+    if (size <= 16) {
+        if (size >= 4) {
+            u64_t offset = (size >> 3) << 2;
+            a = (_re_wyhash_read4(p) << 32) | _re_wyhash_read4(p + offset);
+            b = (_re_wyhash_read4(p + size - 4) << 32) | _re_wyhash_read4(p + size - 4 - offset);
+        } else if (size > 0) {
+            a = ((u64_t) p[0] << 16) | ((u64_t) p[size >> 1] << 8) | p[size - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        u64_t i = size;
+        if (i >= 48) {
+            u64_t seed1 = seed;
+            u64_t seed2 = seed;
+            do {
+                seed = _re_wyhash_mix(_re_wyhash_read8(p) ^ secret[1], _re_wyhash_read8(p + 8) ^ seed);
+                seed1 = _re_wyhash_mix(_re_wyhash_read8(p + 16) ^ secret[2], _re_wyhash_read8(p + 24) ^ seed1);
+                seed2 = _re_wyhash_mix(_re_wyhash_read8(p + 32) ^ secret[3], _re_wyhash_read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i >= 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = _re_wyhash_mix(_re_wyhash_read8(p) ^ secret[1], _re_wyhash_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = _re_wyhash_read8(p + i - 16);
+        b = _re_wyhash_read8(p + i - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    __uint128_t r = (__uint128_t) a * b;
+    a = (u64_t) r;
+    b = (u64_t) (r >> 64);
+    return _re_wyhash_mix(a ^ secret[0] ^ size, b ^ secret[1]);
+}
+
 void re_format_string(char buffer[1024], const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
@@ -296,8 +1032,21 @@ re_str_t re_str_concat(re_str_t a, re_str_t b, re_arena_t *arena) {
     return concat;
 }
 
+u64_t re_str_hash(const void *str, u64_t size) {
+    (void) size;
+    const re_str_t *string = str;
+    return re_wyhash(string->str, string->len);
+}
+
+b8_t re_str_equal(const void *a, const void *b, u32_t size) {
+    (void) size;
+    const re_str_t *x = a;
+    const re_str_t *y = b;
+    return x->len == y->len && (x->len == 0 || memcmp(x->str, y->str, x->len) == 0);
+}
+
 re_str_list_t *re_str_list_append(re_str_list_t *list, re_str_t str, re_arena_t *arena) {
-    re_str_list_t *next = re_arena_push_zero(arena, sizeof(re_str_list_t));
+    re_str_list_t *next = re_arena_push_struct_zero(arena, re_str_list_t);
     next->str = str;
 
     if (list != NULL) {
@@ -326,155 +1075,1417 @@ re_str_t re_str_list_concat(re_str_list_t *list, re_arena_t *arena) {
         }
     }
 
-    return re_str(buffer, len);
+    return re_str(buffer, len);
+}
+
+/*=========================*/
+// Dynamic array
+/*=========================*/
+
+#define _RE_DYN_ARR_INIT_CAP 8
+
+#define head_from_re_dyn_arr(ARR)  ((ARR) ? (re_dyn_arr_head_t *) ((ptr_t) (ARR) - sizeof(re_dyn_arr_head_t)) : &_null_head)
+#define re_dyn_arr_from_head(HEAD) ((void *) ((ptr_t) (HEAD) + sizeof(re_dyn_arr_head_t)))
+
+static re_dyn_arr_head_t _null_head = {0};
+
+// Takes a u64_t count so callers adding to the current count can't wrap.
+static void _re_dyn_arr_ensure(void **arr, u64_t count) {
+    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
+    if (count <= head->capacity) {
+        return;
+    }
+    RE_ENSURE(count <= U32_MAX, "Dynamic array can't hold %llu elements.", count);
+
+    u32_t old_capacity = head->capacity;
+    while (count > head->capacity) {
+        // Clamp before converting, a float past U32_MAX doesn't fit a u32_t.
+        f64_t grown = (f64_t) head->capacity * RE_DYN_ARR_GROWTH_FACTOR;
+        u32_t capacity = grown < (f64_t) U32_MAX ? (u32_t) grown : U32_MAX;
+        // Step by at least one so tiny capacities still grow with 1.5.
+        head->capacity = re_max(head->capacity + 1, capacity);
+    }
+    head = head->allocator.resize(head,
+            sizeof(re_dyn_arr_head_t) + (usize_t) old_capacity * head->size,
+            sizeof(re_dyn_arr_head_t) + (usize_t) head->capacity * head->size,
+            head->allocator.ctx);
+    *arr = re_dyn_arr_from_head(head);
+}
+
+void _re_dyn_arr_new_impl(void **arr, u32_t size) {
+    _re_dyn_arr_new_alloc_impl(arr, size, re_heap_allocator());
+}
+
+void _re_dyn_arr_new_alloc_impl(void **arr, u32_t size, re_allocator_t allocator) {
+    if (*arr != NULL) {
+        return;
+    }
+
+    re_dyn_arr_head_t *head = allocator.alloc(sizeof(re_dyn_arr_head_t) + size * _RE_DYN_ARR_INIT_CAP, allocator.ctx);
+    *head = (re_dyn_arr_head_t) {
+        .allocator = allocator,
+        .capacity = _RE_DYN_ARR_INIT_CAP,
+        .count = 0,
+        .size = size
+    };
+
+    *arr = re_dyn_arr_from_head(head);
+}
+
+void _re_dyn_arr_free_impl(void **arr) {
+    if (*arr == NULL) {
+        return;
+    }
+
+    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
+    head->allocator.free(head, sizeof(re_dyn_arr_head_t) + head->capacity * head->size, head->allocator.ctx);
+    *arr = NULL;
+}
+
+void _re_dyn_arr_grow_impl(void **arr, u32_t size) {
+    _re_dyn_arr_new_impl(arr, size);
+    _re_dyn_arr_ensure(arr, (u64_t) head_from_re_dyn_arr(*arr)->count + 1);
+}
+
+void _re_dyn_arr_shrink_to_fit_impl(void **arr) {
+    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
+    if (*arr == NULL || head->count == head->capacity) {
+        return;
+    }
+
+    head = head->allocator.resize(head,
+            sizeof(re_dyn_arr_head_t) + head->capacity * head->size,
+            sizeof(re_dyn_arr_head_t) + head->count * head->size,
+            head->allocator.ctx);
+    head->capacity = head->count;
+    *arr = re_dyn_arr_from_head(head);
+}
+
+void _re_dyn_arr_insert_fast_impl(void **arr, const void *value, u32_t index) {
+    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
+    RE_ASSERT(index <= head->count, "Dyanmic array insertion out of bounds.");
+
+    _re_dyn_arr_ensure(arr, (u64_t) head->count + 1);
+    head = head_from_re_dyn_arr(*arr);
+
+    ptr_t wanted_pos = (ptr_t) *arr + index * head->size;
+    ptr_t new_pos = (ptr_t) *arr + head->count * head->size;
+
+    // Place old value at the back of the array.
+    if (index != head->count) {
+        memcpy(new_pos, wanted_pos, head->size);
+    }
+    // Place the new value at the index.
+    memcpy(wanted_pos, value, head->size);
+
+    head->count++;
+}
+
+void _re_dyn_arr_insert_arr_impl(void **arr, const void *value_arr, u32_t count, u32_t index) {
+    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
+    RE_ASSERT(index <= head->count, "Dyanmic array insertion out of bounds.");
+
+    _re_dyn_arr_ensure(arr, (u64_t) head->count + count);
+    head = head_from_re_dyn_arr(*arr);
+
+    ptr_t wanted_pos = (ptr_t) *arr + index * head->size;
+    ptr_t new_pos = (ptr_t) *arr + (index + count) * head->size;
+
+    //     V   V
+    // 0 1 2 3 4 5 6 7 8 9
+
+    // Move old values to make room for the new array.
+    memmove(new_pos, wanted_pos, (head->count - index) * head->size);
+    // Place the new array of value in the array.
+    if (value_arr != NULL) {
+        memcpy(wanted_pos, value_arr, count * head->size);
+    } else {
+        memset(wanted_pos, 0, count * head->size);
+    }
+
+    head->count += count;
+}
+
+void _re_dyn_arr_remove_fast_impl(void **arr, u32_t index, void *result) {
+    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
+    RE_ASSERT(index < head->count, "Dyanmic array removal out of bounds.");
+
+    ptr_t end_pos = (ptr_t) *arr + (head->count - 1) * head->size;
+    ptr_t gap_pos = (ptr_t) *arr + index * head->size;
+
+    if (result != NULL) {
+        memcpy(result, gap_pos, head->size);
+    }
+    if (gap_pos != end_pos) {
+        memcpy(gap_pos, end_pos, head->size);
+    }
+
+    head->count--;
+}
+
+void _re_dyn_arr_remove_arr_impl(void **arr, u32_t count, u32_t index, void *out) {
+    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
+    RE_ASSERT(index < head->count && count <= head->count && index + count <= head->count, "Dyanmic array removal range out of bounds.");
+
+    ptr_t begin_pos = (ptr_t) *arr + index * head->size;
+    ptr_t end_pos = (ptr_t) *arr + (index + count) * head->size;
+
+    //     V     V
+    // 0 1 2 3 4 5 6 7 8 9
+
+    if (out != NULL) {
+        memcpy(out, begin_pos, count * head->size);
+    }
+
+    memmove(begin_pos, end_pos, (head->count - index - count) * head->size);
+
+    head->count -= count;
+}
+
+/*=========================*/
+// Hash map
+/*=========================*/
+
+b8_t _re_hash_map_default_equal_func(const void *a, const void *b, u32_t size) {
+    return memcmp(a, b, size) == 0;
+}
+
+#define _RE_HASH_MAP_GROUP_SIZE 16
+#define _RE_HASH_MAP_CTRL_EMPTY 0x80
+#define _RE_HASH_MAP_CTRL_DELETED 0xfe
+
+#define _re_hash_table_field(MAP, TABLE, INDEX, FIELD) \
+    ((TABLE)->buckets + (TABLE)->FIELD##_base + (usize_t) (INDEX) * (MAP)->FIELD##_stride)
+#define _re_hash_table_hash(MAP, TABLE, INDEX) \
+    ((u64_t *) _re_hash_table_field((MAP), (TABLE), (INDEX), hash))
+#define _re_hash_table_state(MAP, TABLE, INDEX) \
+    _re_hash_table_field((MAP), (TABLE), (INDEX), state)
+#define _re_hash_table_key(MAP, TABLE, INDEX) \
+    _re_hash_table_field((MAP), (TABLE), (INDEX), key)
+#define _re_hash_table_value(MAP, TABLE, INDEX) \
+    _re_hash_table_field((MAP), (TABLE), (INDEX), value)
+
+static u32_t _re_hash_map_min_capacity(re_hash_map_engine_t engine) {
+    return engine == RE_HASH_MAP_ENGINE_SWISS ? _RE_HASH_MAP_GROUP_SIZE : 8;
+}
+
+static void _re_hash_table_set_ctrl(_re_hash_table_t *table, u32_t index, u8_t ctrl) {
+    table->ctrl[index] = ctrl;
+    // Mirror the first group after the end so a group can be loaded from
+    // any index without wrapping.
+    if (index < _RE_HASH_MAP_GROUP_SIZE) {
+        table->ctrl[table->capacity + index] = ctrl;
+    }
+}
+
+// Bitmask of the bytes in the 16 byte group equal to value.
+static u32_t _re_hash_map_group_match(const u8_t *group, u8_t value) {
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+    u32_t mask = 0;
+    for (u32_t i = 0; i < _RE_HASH_MAP_GROUP_SIZE; i++) {
+        mask |= (u32_t) (group[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+
+// Bitmask of the empty or deleted bytes in the 16 byte group.
+static u32_t _re_hash_map_group_match_free(const u8_t *group) {
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) group));
+#else
+    u32_t mask = 0;
+    for (u32_t i = 0; i < _RE_HASH_MAP_GROUP_SIZE; i++) {
+        mask |= (u32_t) (group[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
+
+// Works out where every field of the buckets lives without allocating them.
+static void _re_hash_table_layout(const _re_hash_map_t *map, _re_hash_table_t *table, u32_t capacity) {
+    RE_ASSERT((capacity & (capacity - 1)) == 0, "Hash map capacity %u isn't a power of two.", capacity);
+    *table = (_re_hash_table_t) {
+        .capacity = capacity,
+        .mask = capacity - 1,
+    };
+    if (map->flags & RE_HASH_MAP_FLAG_SOA) {
+        table->hash_base = 0;
+        table->state_base = (usize_t) capacity * sizeof(u64_t);
+        table->key_base = re_align_up(table->state_base + capacity, map->key_align);
+        table->value_base = re_align_up(table->key_base + (usize_t) capacity * map->key_size, map->value_align);
+        table->size = table->value_base + (usize_t) capacity * map->value_size;
+    } else {
+        table->hash_base = 0;
+        table->state_base = sizeof(u64_t);
+        table->key_base = map->key_offset;
+        table->value_base = map->value_offset;
+        table->size = (usize_t) capacity * map->bucket_size;
+    }
+}
+
+static void _re_hash_table_alloc(const _re_hash_map_t *map, _re_hash_table_t *table, u32_t capacity) {
+    _re_hash_table_layout(map, table, capacity);
+    // Zeroed allocations let large tables come straight from fresh pages
+    // instead of clearing them here, in the insert that triggered a resize.
+    table->buckets = re_allocator_alloc_zeroed(map->allocator, table->size);
+    if (map->engine == RE_HASH_MAP_ENGINE_SWISS) {
+        table->ctrl = re_allocator_alloc(map->allocator, capacity + _RE_HASH_MAP_GROUP_SIZE);
+        memset(table->ctrl, _RE_HASH_MAP_CTRL_EMPTY, capacity + _RE_HASH_MAP_GROUP_SIZE);
+    }
+}
+
+static void _re_hash_table_free(const _re_hash_map_t *map, _re_hash_table_t *table) {
+    if (table->buckets == NULL) {
+        return;
+    }
+    re_allocator_free(map->allocator, table->buckets, table->size);
+    if (table->ctrl != NULL) {
+        re_allocator_free(map->allocator, table->ctrl, table->capacity + _RE_HASH_MAP_GROUP_SIZE);
+    }
+    *table = (_re_hash_table_t) {0};
+}
+
+static void _re_hash_table_copy(const _re_hash_map_t *map, _re_hash_table_t *dst_table, u32_t dst, const _re_hash_table_t *src_table, u32_t src) {
+    if (map->flags & RE_HASH_MAP_FLAG_SOA) {
+        *_re_hash_table_hash(map, dst_table, dst) = *_re_hash_table_hash(map, src_table, src);
+        *_re_hash_table_state(map, dst_table, dst) = *_re_hash_table_state(map, src_table, src);
+        memcpy(_re_hash_table_key(map, dst_table, dst), _re_hash_table_key(map, src_table, src), map->key_size);
+        memcpy(_re_hash_table_value(map, dst_table, dst), _re_hash_table_value(map, src_table, src), map->value_size);
+    } else {
+        memcpy(_re_hash_table_hash(map, dst_table, dst), _re_hash_table_hash(map, src_table, src), map->bucket_size);
+    }
+}
+
+// Distance of a bucket from where its hash wants it.
+static u32_t _re_hash_table_distance(const _re_hash_map_t *map, const _re_hash_table_t *table, u32_t index) {
+    return (index - (u32_t) *_re_hash_table_hash(map, table, index)) & table->mask;
+}
+
+// Robin Hood: frees the bucket at index by shifting it and the following
+// buckets up to the next inactive one forward by one. Buckets stay ordered
+// by home position, so lookups can still stop early.
+static void _re_hash_table_shift_forward(const _re_hash_map_t *map, _re_hash_table_t *table, u32_t index) {
+    u32_t end = index;
+    while (*_re_hash_table_state(map, table, end) != BUCKET_STATE_INACTIVE) {
+        end = (end + 1) & table->mask;
+    }
+    while (end != index) {
+        u32_t prev = (end - 1) & table->mask;
+        _re_hash_table_copy(map, table, end, table, prev);
+        end = prev;
+    }
+}
+
+// Robin Hood: removes the bucket at index by shifting the following
+// buckets back until one is inactive or already at its home.
+static void _re_hash_table_shift_backward(const _re_hash_map_t *map, _re_hash_table_t *table, u32_t index) {
+    u32_t next = (index + 1) & table->mask;
+    while (*_re_hash_table_state(map, table, next) == BUCKET_STATE_IN_USE &&
+            _re_hash_table_distance(map, table, next) != 0) {
+        _re_hash_table_copy(map, table, index, table, next);
+        index = next;
+        next = (next + 1) & table->mask;
+    }
+    *_re_hash_table_state(map, table, index) = BUCKET_STATE_INACTIVE;
+}
+
+// Finds the bucket holding key. If it isn't found and free_index isn't
+// NULL, the bucket the key should go in is written to it.
+static u32_t _re_hash_table_probe(const _re_hash_map_t *map, const _re_hash_table_t *table, const void *key, u64_t hash, u32_t *free_index) {
+    u32_t first_free = U32_MAX;
+    u32_t mask = table->mask;
+
+    if (map->engine == RE_HASH_MAP_ENGINE_SWISS) {
+        u8_t fragment = hash & 0x7f;
+        u32_t offset = (hash >> 7) & mask;
+        u32_t step = 0;
+        while (true) {
+            const u8_t *group = table->ctrl + offset;
+            u32_t matches = _re_hash_map_group_match(group, fragment);
+            while (matches != 0) {
+                u32_t index = (offset + __builtin_ctz(matches)) & mask;
+                if (*_re_hash_table_hash(map, table, index) == hash &&
+                        map->equal_func(key, _re_hash_table_key(map, table, index), map->key_size)) {
+                    return index;
+                }
+                matches &= matches - 1;
+            }
+
+            u32_t free = _re_hash_map_group_match_free(group);
+            if (first_free == U32_MAX && free != 0) {
+                first_free = (offset + __builtin_ctz(free)) & mask;
+            }
+            if (_re_hash_map_group_match(group, _RE_HASH_MAP_CTRL_EMPTY) != 0) {
+                break;
+            }
+
+            // Triangular probing over groups visits every bucket since the
+            // capacity is a power of two.
+            step += _RE_HASH_MAP_GROUP_SIZE;
+            offset = (offset + step) & mask;
+        }
+    } else if (map->engine == RE_HASH_MAP_ENGINE_ROBIN_HOOD) {
+        u32_t index = hash & mask;
+        u32_t distance = 0;
+        while (true) {
+            // The key would have displaced any bucket closer to its home.
+            u8_t state = *_re_hash_table_state(map, table, index);
+            if (state == BUCKET_STATE_INACTIVE || _re_hash_table_distance(map, table, index) < distance) {
+                first_free = index;
+                break;
+            }
+            // Only the old buckets of an incremental resize have tombstones.
+            if (state == BUCKET_STATE_IN_USE &&
+                    *_re_hash_table_hash(map, table, index) == hash &&
+                    map->equal_func(key, _re_hash_table_key(map, table, index), map->key_size)) {
+                return index;
+            }
+            index = (index + 1) & mask;
+            distance++;
+        }
+    } else {
+        u32_t index = hash & mask;
+        while (true) {
+            u8_t state = *_re_hash_table_state(map, table, index);
+            if (state == BUCKET_STATE_INACTIVE) {
+                if (first_free == U32_MAX) {
+                    first_free = index;
+                }
+                break;
+            } else if (state == BUCKET_STATE_TOMBSTONE) {
+                if (first_free == U32_MAX) {
+                    first_free = index;
+                }
+            } else if (*_re_hash_table_hash(map, table, index) == hash &&
+                    map->equal_func(key, _re_hash_table_key(map, table, index), map->key_size)) {
+                return index;
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+    if (free_index != NULL) {
+        *free_index = first_free;
+    }
+    return U32_MAX;
+}
+
+// Marks the bucket at index, found by a probe for hash, as in use.
+static void _re_hash_table_claim(const _re_hash_map_t *map, _re_hash_table_t *table, u32_t index, u64_t hash) {
+    if (map->engine == RE_HASH_MAP_ENGINE_ROBIN_HOOD) {
+        _re_hash_table_shift_forward(map, table, index);
+    } else if (*_re_hash_table_state(map, table, index) == BUCKET_STATE_TOMBSTONE) {
+        table->tombstone_count--;
+    }
+    *_re_hash_table_hash(map, table, index) = hash;
+    *_re_hash_table_state(map, table, index) = BUCKET_STATE_IN_USE;
+    if (map->engine == RE_HASH_MAP_ENGINE_SWISS) {
+        _re_hash_table_set_ctrl(table, index, hash & 0x7f);
+    }
+}
+
+// Copies a bucket whose key isn't in the table into it.
+static u32_t _re_hash_table_place(const _re_hash_map_t *map, _re_hash_table_t *table, const _re_hash_table_t *src_table, u32_t src) {
+    u64_t hash = *_re_hash_table_hash(map, src_table, src);
+    u32_t index;
+    _re_hash_table_probe(map, table, _re_hash_table_key(map, src_table, src), hash, &index);
+    _re_hash_table_claim(map, table, index, hash);
+    _re_hash_table_copy(map, table, index, src_table, src);
+    return index;
+}
+
+// Removes the bucket at index, leaving a tombstone unless the engine
+// shifts buckets back.
+static void _re_hash_table_remove(const _re_hash_map_t *map, _re_hash_table_t *table, u32_t index) {
+    if (map->engine == RE_HASH_MAP_ENGINE_ROBIN_HOOD && table == &map->table) {
+        _re_hash_table_shift_backward(map, table, index);
+        return;
+    }
+    *_re_hash_table_state(map, table, index) = BUCKET_STATE_TOMBSTONE;
+    if (map->engine == RE_HASH_MAP_ENGINE_SWISS) {
+        _re_hash_table_set_ctrl(table, index, _RE_HASH_MAP_CTRL_DELETED);
+    }
+    table->tombstone_count++;
+}
+
+// Moves a bucket from the old buckets to the current ones.
+static u32_t _re_hash_map_migrate_bucket(_re_hash_map_t *map, u32_t old_index) {
+    u32_t index = _re_hash_table_place(map, &map->table, &map->old_table, old_index);
+    // Old buckets stay in place, so lookups through them keep working.
+    _re_hash_table_remove(map, &map->old_table, old_index);
+    return index;
+}
+
+// Migrates up to bucket_count old buckets of an incremental resize.
+static void _re_hash_map_migrate(_re_hash_map_t *map, u32_t bucket_count) {
+    _re_hash_table_t *old_table = &map->old_table;
+    if (old_table->buckets == NULL) {
+        return;
+    }
+
+    u32_t end = map->migrate_index + re_min(bucket_count, old_table->capacity - map->migrate_index);
+    for (; map->migrate_index < end; map->migrate_index++) {
+        if (*_re_hash_table_state(map, old_table, map->migrate_index) == BUCKET_STATE_IN_USE) {
+            _re_hash_map_migrate_bucket(map, map->migrate_index);
+        }
+    }
+
+    if (map->migrate_index == old_table->capacity) {
+        _re_hash_table_free(map, old_table);
+        map->migrate_index = 0;
+    }
+}
+
+// Rebuilds the buckets at a new capacity, dropping all tombstones.
+static void _re_hash_map_rehash(_re_hash_map_t *map, u32_t capacity) {
+    _re_hash_table_t old_table = map->table;
+    _re_hash_table_alloc(map, &map->table, capacity);
+    for (u32_t i = 0; i < old_table.capacity; i++) {
+        if (*_re_hash_table_state(map, &old_table, i) == BUCKET_STATE_IN_USE) {
+            _re_hash_table_place(map, &map->table, &old_table, i);
+        }
+    }
+    _re_hash_table_free(map, &old_table);
+}
+
+// Rehashes or starts an incremental resize, depending on the map flags.
+static void _re_hash_map_resize(_re_hash_map_t *map, u32_t capacity) {
+    _re_hash_map_migrate(map, U32_MAX);
+    if (map->flags & RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE) {
+        map->old_table = map->table;
+        map->migrate_index = 0;
+        _re_hash_table_alloc(map, &map->table, capacity);
+    } else {
+        _re_hash_map_rehash(map, capacity);
+    }
+}
+
+// Smallest capacity holding count entries without growing.
+static u32_t _re_hash_map_capacity_for(const _re_hash_map_t *map, u32_t count) {
+    u32_t capacity = _re_hash_map_min_capacity(map->engine);
+    while (count >= capacity * _RE_HASH_MAP_MAX_LOAD) {
+        capacity *= _RE_HASH_MAP_GROW_FACTOR;
+    }
+    return capacity;
+}
+
+void _re_hash_map_init_impl(void **map, u32_t map_size, u32_t key_size, u32_t key_align, u32_t value_size, u32_t value_align, const void *null_key, const void *null_value, re_hash_map_desc_t desc) {
+    if (desc.allocator.alloc == NULL) {
+        desc.allocator = re_heap_allocator();
+    }
+    if (desc.hash_func == NULL) {
+        desc.hash_func = re_wyhash;
+    }
+    if (desc.equal_func == NULL) {
+        desc.equal_func = _re_hash_map_default_equal_func;
+    }
+    if (desc.engine == RE_HASH_MAP_ENGINE_ROBIN_HOOD) {
+        desc.flags &= ~RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE;
+    }
+
+    _re_hash_map_t *result = re_allocator_alloc(desc.allocator, map_size);
+    memset(result, 0, map_size);
+    *result = (_re_hash_map_t) {
+        .engine = desc.engine,
+        .flags = desc.flags,
+        .handle_size = map_size,
+        .key_size = key_size,
+        .value_size = value_size,
+        .hash_func = desc.hash_func,
+        .equal_func = desc.equal_func,
+        .allocator = desc.allocator,
+        .key_arena = desc.key_arena,
+    };
+    RE_ASSERT(desc.key_arena == NULL || (desc.flags & _RE_HASH_MAP_FLAG_STR_KEYS), "Key arenas are only supported by re_str_map_init.");
+
+    result->key_align = key_align;
+    result->value_align = value_align;
+    result->key_offset = re_align_up(sizeof(u64_t) + 1, key_align);
+    result->value_offset = re_align_up(result->key_offset + key_size, value_align);
+    u32_t bucket_align = re_max(_Alignof(u64_t), re_max(key_align, value_align));
+    result->bucket_size = re_align_up(result->value_offset + value_size, bucket_align);
+    if (desc.flags & RE_HASH_MAP_FLAG_SOA) {
+        result->hash_stride = sizeof(u64_t);
+        result->state_stride = 1;
+        result->key_stride = key_size;
+        result->value_stride = value_size;
+    } else {
+        result->hash_stride = result->bucket_size;
+        result->state_stride = result->bucket_size;
+        result->key_stride = result->bucket_size;
+        result->value_stride = result->bucket_size;
+    }
+
+    result->null_key = re_allocator_alloc(desc.allocator, key_size);
+    memcpy(result->null_key, null_key, key_size);
+    // Sets have no values.
+    if (value_size > 0) {
+        result->null_value = re_allocator_alloc(desc.allocator, value_size);
+        memcpy(result->null_value, null_value, value_size);
+    }
+
+    _re_hash_table_alloc(result, &result->table, _re_hash_map_capacity_for(result, desc.capacity));
+
+    *map = result;
+}
+
+void _re_hash_map_free_impl(void **map) {
+    _re_hash_map_t *hash_map = *map;
+    if (hash_map == NULL) {
+        return;
+    }
+
+    re_allocator_t allocator = hash_map->allocator;
+    if (hash_map->snapshot != NULL) {
+        // The buckets live in the mapped file.
+        re_os_file_unmap(hash_map->snapshot, hash_map->snapshot_size);
+        hash_map->table = (_re_hash_table_t) {0};
+    }
+    _re_hash_table_free(hash_map, &hash_map->table);
+    _re_hash_table_free(hash_map, &hash_map->old_table);
+    re_allocator_free(allocator, hash_map->null_key, hash_map->key_size);
+    if (hash_map->null_value != NULL) {
+        re_allocator_free(allocator, hash_map->null_value, hash_map->value_size);
+    }
+    re_allocator_free(allocator, hash_map, hash_map->handle_size);
+    *map = NULL;
+}
+
+// Looks for key in the current buckets, then in the old ones of an
+// incremental resize.
+static u32_t _re_hash_map_find(_re_hash_map_t *map, const void *key, u64_t hash, u32_t *free_index) {
+    u32_t index = _re_hash_table_probe(map, &map->table, key, hash, free_index);
+    if (index == U32_MAX && map->old_table.buckets != NULL) {
+        u32_t old_index = _re_hash_table_probe(map, &map->old_table, key, hash, NULL);
+        if (old_index != U32_MAX) {
+            index = _re_hash_map_migrate_bucket(map, old_index);
+        }
+    }
+    return index;
+}
+
+u32_t _re_hash_map_find_impl(_re_hash_map_t *map, const void *key) {
+    u64_t hash = map->hash_func(key, map->key_size);
+    return _re_hash_map_find(map, key, hash, NULL);
+}
+
+// Inserts key unless it's already in the map. There must be room for it.
+static u32_t _re_hash_map_insert(_re_hash_map_t *map, const void *key, u64_t hash, b8_t *new_entry) {
+    u32_t free_index;
+    u32_t index = _re_hash_map_find(map, key, hash, &free_index);
+    *new_entry = index == U32_MAX;
+    if (index != U32_MAX) {
+        return index;
+    }
+
+    _re_hash_table_claim(map, &map->table, free_index, hash);
+    memcpy(_re_hash_table_key(map, &map->table, free_index), key, map->key_size);
+    if (map->key_arena != NULL) {
+        re_str_t *stored = (re_str_t *) _re_hash_table_key(map, &map->table, free_index);
+        *stored = re_str_push_copy(*stored, map->key_arena);
+    }
+    map->count++;
+    return free_index;
+}
+
+// Inserts key, whose hash the caller already has, growing first if needed.
+static u32_t _re_hash_map_insert_hashed(_re_hash_map_t *map, const void *key, u64_t hash, b8_t *new_entry) {
+    RE_ASSERT(map->snapshot == NULL, "Hash map snapshots are read-only.");
+    _re_hash_map_migrate(map, RE_HASH_MAP_MIGRATE_BUCKETS);
+
+    _re_hash_table_t *table = &map->table;
+    if (map->count >= table->capacity * _RE_HASH_MAP_MAX_LOAD) {
+        _re_hash_map_resize(map, table->capacity * _RE_HASH_MAP_GROW_FACTOR);
+    } else if (map->count + table->tombstone_count >= table->capacity * _RE_HASH_MAP_MAX_LOAD) {
+        // Make sure probing always reaches an empty bucket.
+        _re_hash_map_resize(map, table->capacity);
+    }
+
+    return _re_hash_map_insert(map, key, hash, new_entry);
+}
+
+u32_t _re_hash_map_insert_impl(_re_hash_map_t *map, const void *key, b8_t *new_entry) {
+    return _re_hash_map_insert_hashed(map, key, map->hash_func(key, map->key_size), new_entry);
+}
+
+void _re_hash_map_reserve_impl(_re_hash_map_t *map, u32_t count) {
+    RE_ASSERT(map->snapshot == NULL, "Hash map snapshots are read-only.");
+    u32_t capacity = _re_hash_map_capacity_for(map, count);
+    if (capacity > map->table.capacity) {
+        // Reserving is an explicit request to pay for the rehash now.
+        _re_hash_map_migrate(map, U32_MAX);
+        _re_hash_map_rehash(map, capacity);
+    }
+}
+
+void _re_hash_map_set_arr_impl(_re_hash_map_t *map, const void *keys, const void *values, u32_t count) {
+    _re_hash_map_reserve_impl(map, map->count + count);
+    _re_hash_map_migrate(map, U32_MAX);
+
+    // Reserving left room for every key and keeps tombstones below a
+    // quarter of the buckets, so no insert has to check for growth.
+    for (u32_t i = 0; i < count; i++) {
+        const void *key = (const u8_t *) keys + (usize_t) i * map->key_size;
+        b8_t new_entry;
+        u32_t index = _re_hash_map_insert(map, key, map->hash_func(key, map->key_size), &new_entry);
+        memcpy(_re_hash_map_value_ptr(map, index), (const u8_t *) values + (usize_t) i * map->value_size, map->value_size);
+    }
+}
+
+static b8_t _re_hash_map_remove_hashed(_re_hash_map_t *map, const void *key, u64_t hash, void *value) {
+    RE_ASSERT(map->snapshot == NULL, "Hash map snapshots are read-only.");
+    _re_hash_map_migrate(map, RE_HASH_MAP_MIGRATE_BUCKETS);
+
+    u32_t index = _re_hash_map_find(map, key, hash, NULL);
+    if (index == U32_MAX) {
+        return false;
+    }
+
+    if (value != NULL) {
+        memcpy(value, _re_hash_map_value_ptr(map, index), map->value_size);
+    }
+    _re_hash_table_remove(map, &map->table, index);
+    map->count--;
+
+    // Redo bucket array to get rid of tombstones.
+    if (map->table.tombstone_count >= map->table.capacity * _RE_HASH_MAP_MAX_TOMBSTONE_LOAD) {
+        _re_hash_map_resize(map, map->table.capacity);
+    }
+
+    return true;
+}
+
+b8_t _re_hash_map_remove_impl(_re_hash_map_t *map, const void *key, void *value) {
+    return _re_hash_map_remove_hashed(map, key, map->hash_func(key, map->key_size), value);
+}
+
+b8_t _re_hash_map_index_valid_impl(const _re_hash_map_t *map, u32_t index) {
+    return index < map->table.capacity && *_re_hash_table_state(map, &map->table, index) == BUCKET_STATE_IN_USE;
+}
+
+u32_t _re_hash_map_next_impl(_re_hash_map_t *map, u32_t index) {
+    _re_hash_map_migrate(map, U32_MAX);
+    for (u32_t i = index + 1; i < map->table.capacity; i++) {
+        if (*_re_hash_table_state(map, &map->table, i) == BUCKET_STATE_IN_USE) {
+            return i;
+        }
+    }
+    return U32_MAX;
+}
+
+// Snapshots
+
+#define _RE_HASH_MAP_SNAPSHOT_MAGIC 0x50414d4853455255ull
+#define _RE_HASH_MAP_SNAPSHOT_VERSION 1
+// Buckets start on a cache line within the file.
+#define _RE_HASH_MAP_SNAPSHOT_ALIGN 64
+
+typedef struct _re_hash_map_snapshot_header_t _re_hash_map_snapshot_header_t;
+struct _re_hash_map_snapshot_header_t {
+    u64_t magic;
+    u32_t version;
+    u32_t engine;
+    u32_t flags;
+    u32_t key_size;
+    u32_t key_align;
+    u32_t value_size;
+    u32_t value_align;
+    u32_t capacity;
+    u32_t count;
+    u32_t tombstone_count;
+    u64_t hash_seed;
+    u64_t buckets_offset;
+    u64_t buckets_size;
+    u64_t ctrl_offset;
+    u64_t ctrl_size;
+};
+
+b8_t _re_hash_map_save_impl(_re_hash_map_t *map, const char *filepath) {
+    RE_ASSERT(map->key_arena == NULL, "Hash maps with keys in an arena can't be saved.");
+    _re_hash_map_migrate(map, U32_MAX);
+
+    _re_hash_table_t *table = &map->table;
+    _re_hash_map_snapshot_header_t header = {
+        .magic = _RE_HASH_MAP_SNAPSHOT_MAGIC,
+        .version = _RE_HASH_MAP_SNAPSHOT_VERSION,
+        .engine = map->engine,
+        .flags = map->flags,
+        .key_size = map->key_size,
+        .key_align = map->key_align,
+        .value_size = map->value_size,
+        .value_align = map->value_align,
+        .capacity = table->capacity,
+        .count = map->count,
+        .tombstone_count = table->tombstone_count,
+        .hash_seed = _re_state.hash_seed,
+        .buckets_offset = re_align_up(sizeof(header), _RE_HASH_MAP_SNAPSHOT_ALIGN),
+        .buckets_size = table->size,
+    };
+    if (table->ctrl != NULL) {
+        header.ctrl_offset = re_align_up(header.buckets_offset + header.buckets_size, _RE_HASH_MAP_SNAPSHOT_ALIGN);
+        header.ctrl_size = table->capacity + _RE_HASH_MAP_GROUP_SIZE;
+    }
+
+    FILE *fp = fopen(filepath, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    static const u8_t padding[_RE_HASH_MAP_SNAPSHOT_ALIGN] = {0};
+    b8_t result = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+        fwrite(padding, header.buckets_offset - sizeof(header), 1, fp) == 1 &&
+        fwrite(table->buckets, header.buckets_size, 1, fp) == 1;
+    if (result && table->ctrl != NULL) {
+        u64_t padding_size = header.ctrl_offset - header.buckets_offset - header.buckets_size;
+        result = (padding_size == 0 || fwrite(padding, padding_size, 1, fp) == 1) &&
+            fwrite(table->ctrl, header.ctrl_size, 1, fp) == 1;
+    }
+
+    return fclose(fp) == 0 && result;
+}
+
+// Checks a range of the file without overflowing on corrupt offsets.
+static b8_t _re_hash_map_snapshot_range_valid(u64_t offset, u64_t length, usize_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+// Checks everything the loader trusts before using the header, so a corrupt
+// file is refused instead of crashing on the first lookup.
+static b8_t _re_hash_map_snapshot_header_valid(const _re_hash_map_snapshot_header_t *header, usize_t size) {
+    if (size < sizeof(*header) ||
+            header->magic != _RE_HASH_MAP_SNAPSHOT_MAGIC ||
+            header->version != _RE_HASH_MAP_SNAPSHOT_VERSION ||
+            header->engine >= RE_HASH_MAP_ENGINE_COUNT ||
+            (header->flags & ~(RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE | RE_HASH_MAP_FLAG_SOA | _RE_HASH_MAP_FLAG_STR_KEYS)) != 0) {
+        return false;
+    }
+
+    u32_t capacity = header->capacity;
+    // Probing relies on at least one empty bucket.
+    if (capacity < _re_hash_map_min_capacity(header->engine) || (capacity & (capacity - 1)) != 0 ||
+            header->count >= capacity || header->tombstone_count >= capacity - header->count) {
+        return false;
+    }
+
+    if (header->buckets_offset < sizeof(*header) ||
+            header->buckets_offset % _RE_HASH_MAP_SNAPSHOT_ALIGN != 0 ||
+            !_re_hash_map_snapshot_range_valid(header->buckets_offset, header->buckets_size, size)) {
+        return false;
+    }
+    if (header->engine == RE_HASH_MAP_ENGINE_SWISS) {
+        return header->ctrl_size == (u64_t) capacity + _RE_HASH_MAP_GROUP_SIZE &&
+            header->ctrl_offset >= sizeof(*header) &&
+            _re_hash_map_snapshot_range_valid(header->ctrl_offset, header->ctrl_size, size);
+    }
+    return header->ctrl_size == 0;
+}
+
+b8_t _re_hash_map_load_impl(void **map, u32_t map_size, u32_t key_size, u32_t key_align, u32_t value_size, u32_t value_align, const void *null_key, const void *null_value, const char *filepath, re_hash_map_desc_t desc) {
+    usize_t size;
+    const u8_t *snapshot = re_os_file_map(filepath, &size);
+    if (snapshot == NULL) {
+        return false;
+    }
+
+    const _re_hash_map_snapshot_header_t *header = (const _re_hash_map_snapshot_header_t *) snapshot;
+    b8_t valid = _re_hash_map_snapshot_header_valid(header, size) &&
+        header->key_size == key_size && header->key_align == key_align &&
+        header->value_size == value_size && header->value_align == value_align;
+    // Stored hashes are only good for the seed they were made with.
+    if (desc.hash_func == NULL || desc.hash_func == re_wyhash) {
+        valid = valid && header->hash_seed == _re_state.hash_seed;
+    }
+    if (!valid) {
+        re_os_file_unmap(snapshot, size);
+        return false;
+    }
+
+    desc.engine = header->engine;
+    desc.flags = header->flags & ~RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE;
+    desc.capacity = 0;
+    desc.key_arena = NULL;
+    _re_hash_map_init_impl(map, map_size, key_size, key_align, value_size, value_align, null_key, null_value, desc);
+
+    _re_hash_map_t *result = *map;
+    _re_hash_table_free(result, &result->table);
+    result->snapshot = (void *) snapshot;
+    result->snapshot_size = size;
+
+    _re_hash_table_layout(result, &result->table, header->capacity);
+    if (result->table.size != header->buckets_size) {
+        _re_hash_map_free_impl(map);
+        return false;
+    }
+    result->table.buckets = (u8_t *) snapshot + header->buckets_offset;
+    if (header->ctrl_size > 0) {
+        result->table.ctrl = (u8_t *) snapshot + header->ctrl_offset;
+    }
+    result->table.tombstone_count = header->tombstone_count;
+    result->count = header->count;
+
+    return true;
+}
+
+// Hash set
+
+void _re_hash_set_union_impl(_re_hash_map_t *dst, _re_hash_map_t *src) {
+    if (dst == src) {
+        return;
+    }
+    for (u32_t i = _re_hash_map_next_impl(src, U32_MAX); i != U32_MAX; i = _re_hash_map_next_impl(src, i)) {
+        b8_t new_entry;
+        _re_hash_map_insert_impl(dst, _re_hash_map_key_ptr(src, i), &new_entry);
+    }
+}
+
+void _re_hash_set_intersect_impl(_re_hash_map_t *dst, _re_hash_map_t *src) {
+    if (dst == src) {
+        return;
+    }
+    _re_hash_map_migrate(dst, U32_MAX);
+
+    u32_t i = 0;
+    while (i < dst->table.capacity) {
+        if (*_re_hash_table_state(dst, &dst->table, i) != BUCKET_STATE_IN_USE ||
+                (src != NULL && _re_hash_map_find_impl(src, _re_hash_map_key_ptr(dst, i)) != U32_MAX)) {
+            i++;
+            continue;
+        }
+        _re_hash_table_remove(dst, &dst->table, i);
+        dst->count--;
+        // Robin Hood shifts the next bucket into this one, so look at it again.
+        if (dst->engine != RE_HASH_MAP_ENGINE_ROBIN_HOOD) {
+            i++;
+        }
+    }
+
+    if (dst->table.tombstone_count >= dst->table.capacity * _RE_HASH_MAP_MAX_TOMBSTONE_LOAD) {
+        _re_hash_map_resize(dst, dst->table.capacity);
+    }
+}
+
+// Frozen hash map
+
+// Average keys per bucket of the perfect hash. Bigger buckets store fewer
+// displacements but take far more tries to place.
+#define _RE_FROZEN_MAP_BUCKET_LOAD 2
+// Gives up on a bucket after trying this many displacements.
+#define _RE_FROZEN_MAP_MAX_DISPLACEMENT (1u << 20)
+// The hash spreads keys over 5% more slots than there are keys. With no
+// spare slots the last buckets would need about a displacement per key to
+// find the final free ones.
+#define _RE_FROZEN_MAP_SPARE_SLOTS(COUNT) ((COUNT) / 20 + 1)
+
+static u32_t _re_frozen_map_bucket(u64_t hash, u32_t bucket_count) {
+    return ((hash >> 32) * bucket_count) >> 32;
+}
+
+// Mixes a key hash with a displacement into a slot below slot_count,
+// without hashing the key again.
+static u32_t _re_frozen_map_slot(u64_t hash, u32_t displacement, u32_t slot_count) {
+    u64_t x = hash ^ (displacement * 0x9e3779b97f4a7c15ull);
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 29;
+    return ((__uint128_t) x * slot_count) >> 64;
+}
+
+// Finds a displacement sending every hash of a bucket to a free slot and
+// takes those slots.
+static b8_t _re_frozen_map_place_bucket(const u64_t *hashes, u32_t size, u32_t slot_count, u64_t *taken, u32_t *slots, u32_t *displacement) {
+    // Entries with the same hash always land on the same slot.
+    for (u32_t i = 0; i < size; i++) {
+        for (u32_t j = i + 1; j < size; j++) {
+            if (hashes[i] == hashes[j]) {
+                return false;
+            }
+        }
+    }
+
+    for (u32_t d = 0; d < _RE_FROZEN_MAP_MAX_DISPLACEMENT; d++) {
+        u32_t placed = 0;
+        while (placed < size) {
+            u32_t slot = _re_frozen_map_slot(hashes[placed], d, slot_count);
+            u64_t bit = 1ull << (slot % 64);
+            if (taken[slot / 64] & bit) {
+                break;
+            }
+            taken[slot / 64] |= bit;
+            slots[placed] = slot;
+            placed++;
+        }
+        if (placed == size) {
+            *displacement = d;
+            return true;
+        }
+        for (u32_t i = 0; i < placed; i++) {
+            taken[slots[i] / 64] &= ~(1ull << (slots[i] % 64));
+        }
+    }
+    return false;
+}
+
+b8_t _re_frozen_map_init_impl(void **map, u32_t map_size, _re_hash_map_t *src) {
+    re_allocator_t allocator = src->allocator;
+    u32_t count = src->count;
+    u32_t bucket_count = count / _RE_FROZEN_MAP_BUCKET_LOAD + 1;
+    u32_t slot_count = count + _RE_FROZEN_MAP_SPARE_SLOTS(count);
+    u32_t taken_words = slot_count / 64 + 1;
+    // Scratch arrays get one spare entry so none of them is empty.
+    u32_t scratch_count = count + 1;
+
+    usize_t remap_offset = (usize_t) bucket_count * sizeof(u32_t);
+    usize_t keys_offset = re_align_up(remap_offset + (usize_t) (slot_count - count) * sizeof(u32_t), src->key_align);
+    usize_t values_offset = re_align_up(keys_offset + (usize_t) count * src->key_size, src->value_align);
+    usize_t data_size = values_offset + (usize_t) count * src->value_size;
+    u8_t *data = re_allocator_alloc(allocator, data_size);
+    memset(data, 0, data_size);
+    u32_t *displacements = (u32_t *) data;
+    u32_t *remap = (u32_t *) (data + remap_offset);
+
+    // Group the stored hashes by bucket with a counting sort, so a bucket
+    // is tried against the slots without jumping around memory. Iterating
+    // finishes any incremental resize first.
+    u32_t *bucket_start = re_allocator_alloc(allocator, (bucket_count + 1) * sizeof(u32_t));
+    memset(bucket_start, 0, (bucket_count + 1) * sizeof(u32_t));
+    for (u32_t i = _re_hash_map_next_impl(src, U32_MAX); i != U32_MAX; i = _re_hash_map_next_impl(src, i)) {
+        u64_t hash = *_re_hash_table_hash(src, &src->table, i);
+        bucket_start[_re_frozen_map_bucket(hash, bucket_count) + 1]++;
+    }
+    u32_t max_size = 0;
+    for (u32_t b = 0; b < bucket_count; b++) {
+        max_size = re_max(max_size, bucket_start[b + 1]);
+        bucket_start[b + 1] += bucket_start[b];
+    }
+
+    // Remembers where each entry of the map went, in iteration order.
+    u64_t *hashes = re_allocator_alloc(allocator, scratch_count * sizeof(u64_t));
+    u32_t *grouped = re_allocator_alloc(allocator, scratch_count * sizeof(u32_t));
+    u32_t *order = re_allocator_alloc(allocator, bucket_count * sizeof(u32_t));
+    memcpy(order, bucket_start, bucket_count * sizeof(u32_t));
+    u32_t entry_count = 0;
+    for (u32_t i = _re_hash_map_next_impl(src, U32_MAX); i != U32_MAX; i = _re_hash_map_next_impl(src, i)) {
+        u64_t hash = *_re_hash_table_hash(src, &src->table, i);
+        u32_t entry = order[_re_frozen_map_bucket(hash, bucket_count)]++;
+        hashes[entry] = hash;
+        grouped[entry_count++] = entry;
+    }
+
+    // Place the biggest buckets first while most slots are still free,
+    // reusing order to sort buckets by size with another counting sort.
+    u32_t *size_start = re_allocator_alloc(allocator, (max_size + 2) * sizeof(u32_t));
+    memset(size_start, 0, (max_size + 2) * sizeof(u32_t));
+    for (u32_t b = 0; b < bucket_count; b++) {
+        size_start[max_size - (bucket_start[b + 1] - bucket_start[b]) + 1]++;
+    }
+    for (u32_t i = 0; i <= max_size; i++) {
+        size_start[i + 1] += size_start[i];
+    }
+    for (u32_t b = 0; b < bucket_count; b++) {
+        order[size_start[max_size - (bucket_start[b + 1] - bucket_start[b])]++] = b;
+    }
+
+    u64_t *taken = re_allocator_alloc(allocator, taken_words * sizeof(u64_t));
+    memset(taken, 0, taken_words * sizeof(u64_t));
+    u32_t *slots = re_allocator_alloc(allocator, scratch_count * sizeof(u32_t));
+    b8_t placed = true;
+    for (u32_t i = 0; i < bucket_count && placed; i++) {
+        u32_t b = order[i];
+        u32_t start = bucket_start[b];
+        u32_t size = bucket_start[b + 1] - start;
+        if (size == 0) {
+            break;
+        }
+        placed = _re_frozen_map_place_bucket(&hashes[start], size, slot_count, taken, &slots[start], &displacements[b]);
+    }
+
+    // Every key placed on a spare slot is sent to one of the holes left
+    // below count instead.
+    u32_t hole = 0;
+    for (u32_t slot = count; slot < slot_count && placed; slot++) {
+        if (!(taken[slot / 64] & (1ull << (slot % 64)))) {
+            continue;
+        }
+        while (taken[hole / 64] & (1ull << (hole % 64))) {
+            hole++;
+        }
+        remap[slot - count] = hole++;
+    }
+
+    if (placed) {
+        _re_frozen_map_t *result = re_allocator_alloc(allocator, map_size);
+        memset(result, 0, map_size);
+        *result = (_re_frozen_map_t) {
+            .handle_size = map_size,
+            .count = count,
+            .key_size = src->key_size,
+            .value_size = src->value_size,
+            .bucket_count = bucket_count,
+            .slot_count = slot_count,
+            .displacements = displacements,
+            .remap = remap,
+            .keys = data + keys_offset,
+            .values = data + values_offset,
+            .data_size = data_size,
+            .hash_func = src->hash_func,
+            .equal_func = src->equal_func,
+            .allocator = allocator,
+        };
+        if (src->value_size > 0) {
+            result->null_value = re_allocator_alloc(allocator, src->value_size);
+            memcpy(result->null_value, src->null_value, src->value_size);
+        }
+        // Walk the map in order again, so only the writes are scattered.
+        u32_t n = 0;
+        for (u32_t i = _re_hash_map_next_impl(src, U32_MAX); i != U32_MAX; i = _re_hash_map_next_impl(src, i)) {
+            u32_t slot = slots[grouped[n++]];
+            if (slot >= count) {
+                slot = remap[slot - count];
+            }
+            memcpy(result->keys + (usize_t) slot * src->key_size, _re_hash_table_key(src, &src->table, i), src->key_size);
+            memcpy(result->values + (usize_t) slot * src->value_size, _re_hash_table_value(src, &src->table, i), src->value_size);
+        }
+        *map = result;
+    } else {
+        re_allocator_free(allocator, data, data_size);
+    }
+
+    re_allocator_free(allocator, slots, scratch_count * sizeof(u32_t));
+    re_allocator_free(allocator, taken, taken_words * sizeof(u64_t));
+    re_allocator_free(allocator, size_start, (max_size + 2) * sizeof(u32_t));
+    re_allocator_free(allocator, order, bucket_count * sizeof(u32_t));
+    re_allocator_free(allocator, grouped, scratch_count * sizeof(u32_t));
+    re_allocator_free(allocator, hashes, scratch_count * sizeof(u64_t));
+    re_allocator_free(allocator, bucket_start, (bucket_count + 1) * sizeof(u32_t));
+
+    return placed;
+}
+
+void _re_frozen_map_free_impl(void **map) {
+    _re_frozen_map_t *frozen_map = *map;
+    if (frozen_map == NULL) {
+        return;
+    }
+
+    re_allocator_t allocator = frozen_map->allocator;
+    re_allocator_free(allocator, frozen_map->displacements, frozen_map->data_size);
+    if (frozen_map->null_value != NULL) {
+        re_allocator_free(allocator, frozen_map->null_value, frozen_map->value_size);
+    }
+    re_allocator_free(allocator, frozen_map, frozen_map->handle_size);
+    *map = NULL;
 }
 
-/*=========================*/
-// Dynamic array
-/*=========================*/
+u32_t _re_frozen_map_find_impl(const _re_frozen_map_t *map, const void *key) {
+    if (map->count == 0) {
+        return U32_MAX;
+    }
 
-#define _RE_DYN_ARR_INIT_CAP 8
+    u64_t hash = map->hash_func(key, map->key_size);
+    u32_t displacement = map->displacements[_re_frozen_map_bucket(hash, map->bucket_count)];
+    u32_t index = _re_frozen_map_slot(hash, displacement, map->slot_count);
+    if (index >= map->count) {
+        index = map->remap[index - map->count];
+    }
+    if (!map->equal_func(key, map->keys + (usize_t) index * map->key_size, map->key_size)) {
+        return U32_MAX;
+    }
+    return index;
+}
 
-typedef struct re_dyn_arr_head_t re_dyn_arr_head_t;
-struct re_dyn_arr_head_t {
-    u32_t capacity;
-    u32_t count;
-    u32_t size;
-};
+// Shared hash map
 
-#define head_from_re_dyn_arr(ARR)  ((ARR) ? (re_dyn_arr_head_t *) ((ptr_t) (ARR) - sizeof(re_dyn_arr_head_t)) : &_null_head)
-#define re_dyn_arr_from_head(HEAD) ((void *) ((ptr_t) (HEAD) + sizeof(re_dyn_arr_head_t)))
+struct _re_hash_map_shard_t {
+    re_mutex_t *lock;
+    _re_hash_map_t *map;
+} __attribute__((aligned(64)));
 
-static re_dyn_arr_head_t _null_head = {0};
+// Shards by the high half of the hash. The shard maps index with the low
+// half, so the same hash is passed on to them instead of hashing again.
+static _re_hash_map_shard_t *_re_shared_hash_map_shard(_re_shared_hash_map_t *map, u64_t hash) {
+    return &map->shards[(hash >> 32) & map->shard_mask];
+}
 
-static void _re_dyn_arr_ensure(void **arr, u32_t count) {
-    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
-    if (count <= head->capacity) {
-        return;
+void _re_shared_hash_map_init_impl(void **map, u32_t map_size, u32_t key_size, u32_t key_align, u32_t value_size, u32_t value_align, const void *null_key, const void *null_value, re_hash_map_desc_t desc) {
+    if (desc.allocator.alloc == NULL) {
+        desc.allocator = re_heap_allocator();
     }
-
-    while (count > head->capacity) {
-        head->capacity *= 2;
+    if (desc.hash_func == NULL) {
+        desc.hash_func = re_wyhash;
     }
-    head = re_realloc(head, sizeof(re_dyn_arr_head_t) + head->capacity * head->size);
-    *arr = re_dyn_arr_from_head(head);
-}
+    RE_ENSURE(desc.key_arena == NULL, "Shared hash maps can't copy keys into an arena.");
+    RE_ENSURE(desc.allocator.alloc == _re_heap_alloc, "Shared hash maps only support the heap allocator.");
 
-void _re_dyn_arr_new_impl(void **arr, u32_t size) {
-    if (*arr != NULL) {
-        return;
+    u32_t shard_count = 1;
+    while (shard_count < re_os_get_processor_count() * RE_SHARED_HASH_MAP_SHARDS_PER_CORE) {
+        shard_count *= 2;
     }
 
-    re_dyn_arr_head_t *head = re_malloc(sizeof(re_dyn_arr_head_t) + size * _RE_DYN_ARR_INIT_CAP);
-    *head = (re_dyn_arr_head_t) {
-        .capacity = _RE_DYN_ARR_INIT_CAP,
-        .count = 0,
-        .size = size
+    _re_shared_hash_map_t *result = re_allocator_alloc(desc.allocator, map_size);
+    memset(result, 0, map_size);
+    *result = (_re_shared_hash_map_t) {
+        .handle_size = map_size,
+        .shard_mask = shard_count - 1,
+        .hash_func = desc.hash_func,
+        .allocator = desc.allocator,
     };
 
-    *arr = re_dyn_arr_from_head(head);
+    // Keep shards on their own cache lines so their locks don't share one.
+    usize_t shards_size = shard_count * sizeof(_re_hash_map_shard_t) + _Alignof(_re_hash_map_shard_t);
+    void *shards = re_allocator_alloc(desc.allocator, shards_size);
+    result->shards_allocation = shards;
+    result->shards = (_re_hash_map_shard_t *) re_align_up(re_ptr_to_usize(shards), _Alignof(_re_hash_map_shard_t));
+
+    desc.capacity = (desc.capacity + shard_count - 1) / shard_count;
+    for (u32_t i = 0; i < shard_count; i++) {
+        _re_hash_map_shard_t *shard = &result->shards[i];
+        shard->lock = re_mutex_create_alloc(desc.allocator);
+        _re_hash_map_init_impl((void **) &shard->map, sizeof(_re_hash_map_t), key_size, key_align, value_size, value_align, null_key, null_value, desc);
+    }
+    *map = result;
 }
 
-void _re_dyn_arr_free_impl(void **arr) {
-    if (*arr == NULL) {
+void _re_shared_hash_map_free_impl(void **map) {
+    _re_shared_hash_map_t *shared_map = *map;
+    if (shared_map == NULL) {
         return;
     }
 
-    re_free(head_from_re_dyn_arr(*arr));
-    *arr = NULL;
+    re_allocator_t allocator = shared_map->allocator;
+    for (u32_t i = 0; i <= shared_map->shard_mask; i++) {
+        _re_hash_map_shard_t *shard = &shared_map->shards[i];
+        re_mutex_destroy(shard->lock);
+        _re_hash_map_free_impl((void **) &shard->map);
+    }
+    re_allocator_free(allocator, shared_map->shards_allocation,
+            (shared_map->shard_mask + 1) * sizeof(_re_hash_map_shard_t) + _Alignof(_re_hash_map_shard_t));
+    re_allocator_free(allocator, shared_map, shared_map->handle_size);
+    *map = NULL;
+}
+
+void _re_shared_hash_map_set_impl(_re_shared_hash_map_t *map, const void *key, const void *value) {
+    u64_t hash = map->hash_func(key, map->shards[0].map->key_size);
+    _re_hash_map_shard_t *shard = _re_shared_hash_map_shard(map, hash);
+    re_mutex_lock(shard->lock);
+    b8_t new_entry;
+    u32_t index = _re_hash_map_insert_hashed(shard->map, key, hash, &new_entry);
+    memcpy(_re_hash_map_value_ptr(shard->map, index), value, shard->map->value_size);
+    re_mutex_unlock(shard->lock);
+}
+
+b8_t _re_shared_hash_map_get_impl(_re_shared_hash_map_t *map, const void *key, void *value) {
+    u64_t hash = map->hash_func(key, map->shards[0].map->key_size);
+    _re_hash_map_shard_t *shard = _re_shared_hash_map_shard(map, hash);
+    re_mutex_lock(shard->lock);
+    u32_t index = _re_hash_map_find(shard->map, key, hash, NULL);
+    if (value != NULL) {
+        const void *source = index != U32_MAX ? _re_hash_map_value_ptr(shard->map, index) : shard->map->null_value;
+        memcpy(value, source, shard->map->value_size);
+    }
+    re_mutex_unlock(shard->lock);
+    return index != U32_MAX;
 }
 
-u32_t re_dyn_arr_count(void *arr) {
-    return head_from_re_dyn_arr(arr)->count;
+b8_t _re_shared_hash_map_remove_impl(_re_shared_hash_map_t *map, const void *key, void *value) {
+    u64_t hash = map->hash_func(key, map->shards[0].map->key_size);
+    _re_hash_map_shard_t *shard = _re_shared_hash_map_shard(map, hash);
+    re_mutex_lock(shard->lock);
+    b8_t found = _re_hash_map_remove_hashed(shard->map, key, hash, value);
+    if (!found && value != NULL) {
+        memcpy(value, shard->map->null_value, shard->map->value_size);
+    }
+    re_mutex_unlock(shard->lock);
+    return found;
 }
 
-u32_t re_dyn_arr_size(void *arr) {
-    return head_from_re_dyn_arr(arr)->size;
+u32_t _re_shared_hash_map_count_impl(_re_shared_hash_map_t *map) {
+    u32_t count = 0;
+    for (u32_t i = 0; i <= map->shard_mask; i++) {
+        _re_hash_map_shard_t *shard = &map->shards[i];
+        re_mutex_lock(shard->lock);
+        count += shard->map->count;
+        re_mutex_unlock(shard->lock);
+    }
+    return count;
 }
 
-void _re_dyn_arr_insert_fast_impl(void **arr, const void *value, u32_t index) {
-    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
-    RE_ASSERT(index <= head->count, "Dyanmic array insertion out of bounds.");
-
-    _re_dyn_arr_ensure(arr, head->count + 1);
-    head = head_from_re_dyn_arr(*arr);
+// Index map
 
-    ptr_t wanted_pos = (ptr_t) *arr + index * head->size;
-    ptr_t new_pos = (ptr_t) *arr + head->count * head->size;
+struct _re_index_map_slot_t {
+    // Entry index plus one, zero marks an empty slot.
+    u32_t entry;
+    // Low half of the key hash, enough to find the home slot.
+    u32_t hash;
+};
 
-    // Place old value at the back of the array.
-    memcpy(new_pos, wanted_pos, head->size);
-    // Place the new value at the index.
-    memcpy(wanted_pos, value, head->size);
+static void _re_index_map_alloc_slots(_re_index_map_t *map, u32_t capacity) {
+    map->capacity = capacity;
+    map->mask = capacity - 1;
+    map->slots = re_allocator_alloc(map->allocator, capacity * sizeof(_re_index_map_slot_t));
+    memset(map->slots, 0, capacity * sizeof(_re_index_map_slot_t));
+}
 
-    head->count++;
+static void *_re_index_map_entry(const _re_index_map_t *map, u32_t index) {
+    return (u8_t *) map->entries + (usize_t) index * re_dyn_arr_size(map->entries);
 }
 
-void _re_dyn_arr_insert_arr_impl(void **arr, const void *value_arr, u32_t count, u32_t index) {
-    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
-    RE_ASSERT(index <= head->count, "Dyanmic array insertion out of bounds.");
+// Finds the slot of key or the empty slot ending its probe sequence.
+static u32_t _re_index_map_probe(const _re_index_map_t *map, const void *key, u32_t hash) {
+    u32_t index = hash & map->mask;
+    while (true) {
+        _re_index_map_slot_t slot = map->slots[index];
+        if (slot.entry == 0 ||
+                (slot.hash == hash && map->equal_func(key, _re_index_map_entry(map, slot.entry - 1), map->key_size))) {
+            return index;
+        }
+        index = (index + 1) & map->mask;
+    }
+}
 
-    _re_dyn_arr_ensure(arr, head->count + count);
-    head = head_from_re_dyn_arr(*arr);
+static void _re_index_map_grow(_re_index_map_t *map) {
+    _re_index_map_slot_t *old_slots = map->slots;
+    u32_t old_capacity = map->capacity;
 
-    ptr_t wanted_pos = (ptr_t) *arr + index * head->size;
-    ptr_t new_pos = (ptr_t) *arr + (index + count) * head->size;
+    _re_index_map_alloc_slots(map, old_capacity * 2);
+    for (u32_t i = 0; i < old_capacity; i++) {
+        if (old_slots[i].entry == 0) {
+            continue;
+        }
+        u32_t index = old_slots[i].hash & map->mask;
+        while (map->slots[index].entry != 0) {
+            index = (index + 1) & map->mask;
+        }
+        map->slots[index] = old_slots[i];
+    }
 
-    //     V   V
-    // 0 1 2 3 4 5 6 7 8 9
+    re_allocator_free(map->allocator, old_slots, old_capacity * sizeof(_re_index_map_slot_t));
+}
 
-    // Move old values to make room for the new array.
-    memmove(new_pos, wanted_pos, (head->count - index) * head->size);
-    // Place the new array of value in the array.
-    if (value_arr != NULL) {
-        memcpy(wanted_pos, value_arr, count * head->size);
-    } else {
-        memset(wanted_pos, 0, count * head->size);
+// Empties a slot, moving later slots of the same cluster back so every
+// probe sequence stays unbroken.
+static void _re_index_map_clear_slot(_re_index_map_t *map, u32_t index) {
+    u32_t next = index;
+    while (true) {
+        next = (next + 1) & map->mask;
+        if (map->slots[next].entry == 0) {
+            break;
+        }
+        // A slot can fill the hole if its home isn't cyclically within
+        // (index, next].
+        u32_t home = map->slots[next].hash & map->mask;
+        if (((next - home) & map->mask) >= ((next - index) & map->mask)) {
+            map->slots[index] = map->slots[next];
+            index = next;
+        }
     }
-
-    head->count += count;
+    map->slots[index] = (_re_index_map_slot_t) {0};
 }
 
-void _re_dyn_arr_remove_fast_impl(void **arr, u32_t index, void *result) {
-    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
-    RE_ASSERT(index < head->count, "Dyanmic array removal out of bounds.");
+void _re_index_map_init_impl(void **map, u32_t map_size, u32_t key_size, u32_t value_size, u32_t value_offset, u32_t entry_size, const void *null_entry, re_hash_map_desc_t desc) {
+    if (desc.allocator.alloc == NULL) {
+        desc.allocator = re_heap_allocator();
+    }
+    if (desc.hash_func == NULL) {
+        desc.hash_func = re_wyhash;
+    }
+    if (desc.equal_func == NULL) {
+        desc.equal_func = _re_hash_map_default_equal_func;
+    }
 
-    ptr_t end_pos = (ptr_t) *arr + (head->count - 1) * head->size;
-    ptr_t gap_pos = (ptr_t) *arr + index * head->size;
+    _re_index_map_t *result = re_allocator_alloc(desc.allocator, map_size);
+    memset(result, 0, map_size);
+    *result = (_re_index_map_t) {
+        .handle_size = map_size,
+        .key_size = key_size,
+        .value_size = value_size,
+        .value_offset = value_offset,
+        .hash_func = desc.hash_func,
+        .equal_func = desc.equal_func,
+        .allocator = desc.allocator,
+    };
 
-    if (result != NULL) {
-        memcpy(result, gap_pos, head->size);
+    result->null_entry = re_allocator_alloc(desc.allocator, entry_size);
+    memcpy(result->null_entry, null_entry, entry_size);
+    _re_dyn_arr_new_alloc_impl(&result->entries, entry_size, desc.allocator);
+
+    u32_t capacity = 8;
+    while (desc.capacity >= capacity * _RE_HASH_MAP_MAX_LOAD) {
+        capacity *= 2;
     }
-    memcpy(gap_pos, end_pos, head->size);
+    _re_index_map_alloc_slots(result, capacity);
 
-    head->count--;
+    *map = result;
 }
 
-void _re_dyn_arr_remove_arr_impl(void **arr, u32_t count, u32_t index, void *out) {
-    re_dyn_arr_head_t *head = head_from_re_dyn_arr(*arr);
-    RE_ASSERT(index < head->count && count <= head->count && index + count <= head->count, "Dyanmic array removal range out of bounds.");
+void _re_index_map_free_impl(void **map) {
+    _re_index_map_t *index_map = *map;
+    if (index_map == NULL) {
+        return;
+    }
 
-    ptr_t begin_pos = (ptr_t) *arr + index * head->size;
-    ptr_t end_pos = (ptr_t) *arr + (index + count) * head->size;
+    re_allocator_t allocator = index_map->allocator;
+    re_allocator_free(allocator, index_map->slots, index_map->capacity * sizeof(_re_index_map_slot_t));
+    re_allocator_free(allocator, index_map->null_entry, re_dyn_arr_size(index_map->entries));
+    _re_dyn_arr_free_impl(&index_map->entries);
+    re_allocator_free(allocator, index_map, index_map->handle_size);
+    *map = NULL;
+}
 
-    //     V     V
-    // 0 1 2 3 4 5 6 7 8 9
+u32_t _re_index_map_find_impl(const _re_index_map_t *map, const void *key) {
+    u32_t hash = map->hash_func(key, map->key_size);
+    u32_t entry = map->slots[_re_index_map_probe(map, key, hash)].entry;
+    return entry != 0 ? entry - 1 : U32_MAX;
+}
 
-    if (out != NULL) {
-        memcpy(out, begin_pos, count * head->size);
+u32_t _re_index_map_insert_impl(_re_index_map_t *map, const void *key, b8_t *new_entry) {
+    u32_t count = re_dyn_arr_count(map->entries);
+    if (count >= map->capacity * _RE_HASH_MAP_MAX_LOAD) {
+        _re_index_map_grow(map);
     }
 
-    memmove(begin_pos, end_pos, (head->count - index - count) * head->size);
+    u32_t hash = map->hash_func(key, map->key_size);
+    u32_t index = _re_index_map_probe(map, key, hash);
+    *new_entry = map->slots[index].entry == 0;
+    if (!*new_entry) {
+        return map->slots[index].entry - 1;
+    }
 
-    head->count -= count;
+    _re_dyn_arr_insert_fast_impl(&map->entries, map->null_entry, count);
+    memcpy(_re_index_map_entry(map, count), key, map->key_size);
+    map->slots[index] = (_re_index_map_slot_t) {
+        .entry = count + 1,
+        .hash = hash
+    };
+    return count;
 }
 
-/*=========================*/
-// Hash map
-/*=========================*/
+b8_t _re_index_map_remove_impl(_re_index_map_t *map, const void *key, void *entry) {
+    u32_t hash = map->hash_func(key, map->key_size);
+    u32_t index = _re_index_map_probe(map, key, hash);
+    u32_t removed = map->slots[index].entry;
+    if (removed == 0) {
+        return false;
+    }
+    _re_index_map_clear_slot(map, index);
+
+    // Point the slot of the last entry to where it's about to be moved.
+    u32_t last = re_dyn_arr_count(map->entries);
+    if (removed != last) {
+        void *last_key = _re_index_map_entry(map, last - 1);
+        u32_t last_hash = map->hash_func(last_key, map->key_size);
+        u32_t last_index = last_hash & map->mask;
+        while (map->slots[last_index].entry != last) {
+            last_index = (last_index + 1) & map->mask;
+        }
+        map->slots[last_index].entry = removed;
+    }
 
-b8_t _re_hash_map_default_equal_func(const void *a, const void *b, u32_t size) {
-    return memcmp(a, b, size) == 0;
+    _re_dyn_arr_remove_fast_impl(&map->entries, removed - 1, entry);
+    return true;
 }
 
 /*=========================*/
@@ -905,6 +2916,11 @@ struct _re_pool_node_t {
     u32_t generation;
 };
 
+// Objects follow their node directly, padded so they are suitably aligned
+// for SIMD types such as re_vec4_t.
+#define _RE_POOL_ALIGNMENT 16
+#define _RE_POOL_NODE_SIZE re_align_up(sizeof(_re_pool_node_t), _RE_POOL_ALIGNMENT)
+
 struct re_pool_t {
     re_arena_t *arena;
     u32_t size;
@@ -914,7 +2930,7 @@ struct re_pool_t {
 };
 
 re_pool_t *re_pool_create(u32_t object_size, re_arena_t *arena) {
-    re_pool_t *pool = re_arena_push(arena, sizeof(re_pool_t));
+    re_pool_t *pool = re_arena_push_struct(arena, re_pool_t);
 
     pool->arena = arena;
     pool->size = object_size;
@@ -936,7 +2952,7 @@ re_pool_handle_t re_pool_new(re_pool_t *pool) {
         }
         pool->free_node = node->next;
     } else {
-        node = re_arena_push_zero(pool->arena, sizeof(_re_pool_node_t) + pool->size);
+        node = re_arena_push_aligned_zero(pool->arena, _RE_POOL_NODE_SIZE + pool->size, _RE_POOL_ALIGNMENT);
         node->index = re_arena_get_pos(pool->arena) - pool->size;
     }
 
@@ -955,7 +2971,7 @@ re_pool_handle_t re_pool_new(re_pool_t *pool) {
 }
 
 void re_pool_delete(re_pool_handle_t handle) {
-    _re_pool_node_t *node = (_re_pool_node_t *) ((ptr_t) re_pool_get_ptr(handle) - sizeof(_re_pool_node_t));
+    _re_pool_node_t *node = (_re_pool_node_t *) ((ptr_t) re_pool_get_ptr(handle) - _RE_POOL_NODE_SIZE);
     if (handle.pool->free_node != NULL) {
         handle.pool->free_node->prev = node;
     }
@@ -981,7 +2997,7 @@ b8_t re_pool_handle_valid(re_pool_handle_t handle) {
         return false;
     }
 
-    _re_pool_node_t *node = (_re_pool_node_t *) ((ptr_t) re_pool_get_ptr(handle) - sizeof(_re_pool_node_t));
+    _re_pool_node_t *node = (_re_pool_node_t *) ((ptr_t) re_pool_get_ptr(handle) - _RE_POOL_NODE_SIZE);
     return node->generation == handle.generation;
 }
 
@@ -989,6 +3005,38 @@ void *re_pool_get_ptr(re_pool_handle_t handle) {
     return re_arena_get_index(handle.index, handle.pool->arena);
 }
 
+static void *_re_pool_allocator_alloc(usize_t size, void *ctx) {
+    re_pool_t *pool = ctx;
+    RE_ENSURE(size <= pool->size, "Allocating %lu bytes from a pool of %u byte objects.", size, pool->size);
+    return re_pool_get_ptr(re_pool_new(pool));
+}
+
+static void *_re_pool_allocator_resize(void *ptr, usize_t old_size, usize_t new_size, void *ctx) {
+    (void) old_size;
+    re_pool_t *pool = ctx;
+    RE_ENSURE(new_size <= pool->size, "Resizing to %lu bytes in a pool of %u byte objects.", new_size, pool->size);
+    return ptr;
+}
+
+static void _re_pool_allocator_free(void *ptr, usize_t size, void *ctx) {
+    (void) size;
+    _re_pool_node_t *node = (_re_pool_node_t *) ((ptr_t) ptr - _RE_POOL_NODE_SIZE);
+    re_pool_delete((re_pool_handle_t) {
+            .pool = ctx,
+            .index = node->index,
+            .generation = node->generation
+        });
+}
+
+re_allocator_t re_pool_allocator(re_pool_t *pool) {
+    return (re_allocator_t) {
+        .alloc = _re_pool_allocator_alloc,
+        .resize = _re_pool_allocator_resize,
+        .free = _re_pool_allocator_free,
+        .ctx = pool
+    };
+}
+
 re_pool_iter_t re_pool_iter_new(re_pool_t *pool) {
     if (pool->used_nodes == NULL) {
         return (re_pool_iter_t) {NULL, U32_MAX};
@@ -1005,7 +3053,7 @@ b8_t re_pool_iter_valid(re_pool_iter_t iter) {
 }
 
 void re_pool_iter_next(re_pool_iter_t *iter) {
-    _re_pool_node_t *node = (_re_pool_node_t *) ((ptr_t) re_arena_get_index(iter->index, iter->pool->arena) - sizeof(_re_pool_node_t));
+    _re_pool_node_t *node = (_re_pool_node_t *) ((ptr_t) re_arena_get_index(iter->index, iter->pool->arena) - _RE_POOL_NODE_SIZE);
     if (node->next == NULL) {
         iter->index = U32_MAX;
         iter->pool = NULL;
@@ -1020,7 +3068,7 @@ re_pool_handle_t re_pool_iter_get(re_pool_iter_t iter) {
         return RE_POOL_INVALID_HANDLE;
     }
 
-    _re_pool_node_t *node = (_re_pool_node_t *) ((ptr_t) re_arena_get_index(iter.index, iter.pool->arena) - sizeof(_re_pool_node_t));
+    _re_pool_node_t *node = (_re_pool_node_t *) ((ptr_t) re_arena_get_index(iter.index, iter.pool->arena) - _RE_POOL_NODE_SIZE);
     return (re_pool_handle_t) {
         .pool = iter.pool,
         .index = node->index,
@@ -1122,6 +3170,7 @@ struct _re_os_state_t {
     f32_t start_time;
     u32_t processor_count;
     u32_t page_size;
+    u32_t huge_page_size;
 };
 
 static _re_os_state_t _re_os_state = {0};
@@ -1133,6 +3182,20 @@ void re_os_init(void) {
 
     _re_os_state.processor_count = sysconf(_SC_NPROCESSORS_ONLN);
     _re_os_state.page_size = getpagesize();
+
+    _re_os_state.huge_page_size = MB(2);
+    FILE *fp = fopen("/proc/meminfo", "r");
+    if (fp != NULL) {
+        char line[256];
+        u32_t kb = 0;
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            if (sscanf(line, "Hugepagesize: %u kB", &kb) == 1) {
+                _re_os_state.huge_page_size = KB(kb);
+                break;
+            }
+        }
+        fclose(fp);
+    }
 }
 
 void re_os_terminate(void) {
@@ -1144,10 +3207,12 @@ void re_os_terminate(void) {
 
 struct re_lib_t {
     void *handle;
+    re_allocator_t allocator;
 };
 
 struct re_mutex_t {
     pthread_mutex_t handle;
+    re_allocator_t allocator;
 };
 
 /*=========================*/
@@ -1155,6 +3220,10 @@ struct re_mutex_t {
 /*=========================*/
 
 re_lib_t *re_lib_load(const char *path, re_lib_mode_t mode) {
+    return re_lib_load_alloc(path, mode, re_heap_allocator());
+}
+
+re_lib_t *re_lib_load_alloc(const char *path, re_lib_mode_t mode, re_allocator_t allocator) {
     u32_t posix_mode = 0;
     switch (mode) {
         case RE_LIB_MODE_LOCAL:
@@ -1165,11 +3234,12 @@ re_lib_t *re_lib_load(const char *path, re_lib_mode_t mode) {
             break;
     }
 
-    re_lib_t *lib = re_malloc(sizeof(re_lib_t));
+    re_lib_t *lib = re_allocator_alloc(allocator, sizeof(re_lib_t));
     *lib = (re_lib_t){0};
+    lib->allocator = allocator;
     lib->handle = dlopen(path, RTLD_LAZY | posix_mode);
     if (lib->handle == NULL) {
-        re_free(lib);
+        re_allocator_free(allocator, lib, sizeof(re_lib_t));
         return NULL;
     }
     return lib;
@@ -1182,7 +3252,7 @@ void re_lib_unload(re_lib_t *lib) {
 
     dlclose(lib->handle);
     lib->handle = NULL;
-    re_free(lib);
+    re_allocator_free(lib->allocator, lib, sizeof(re_lib_t));
 }
 
 re_func_ptr_t re_lib_func(const re_lib_t *lib, const char *name) {
@@ -1207,16 +3277,22 @@ struct _re_thread_context_t {
 
 static void *_re_thread_func_cleanup(void *arg) {
     _re_thread_context_t ctx = *(_re_thread_context_t *) arg;
+    re_free(arg);
     ctx.func(ctx.arg);
-    _re_arena_scratch_destroy();
+    if (_re_state.scratch_recycle) {
+        re_arena_scratch_recycle();
+    } else {
+        _re_arena_scratch_destroy();
+    }
     return NULL;
 }
 
 re_thread_t re_thread_create(re_thread_func_t func, void *arg) {
     re_thread_t thread = {0};
 
-    re_arena_temp_t scratch = re_arena_scratch_get(NULL, 0);
-    _re_thread_context_t *ctx = re_arena_push(scratch.arena, sizeof(_re_thread_context_t));
+    // Heap allocated and freed by the new thread. A scratch allocation could
+    // be reused by the next push before the thread got to read it.
+    _re_thread_context_t *ctx = re_malloc(sizeof(_re_thread_context_t));
     *ctx = (_re_thread_context_t) {
         .func = func,
         .arg = arg
@@ -1226,7 +3302,6 @@ re_thread_t re_thread_create(re_thread_func_t func, void *arg) {
             NULL,
             _re_thread_func_cleanup,
             ctx);
-    re_arena_scratch_release(&scratch);
 
     return thread;
 }
@@ -1235,16 +3310,23 @@ void re_thread_destroy(re_thread_t thread) { (void)thread; }
 
 void re_thread_wait(re_thread_t thread) { pthread_join(thread.handle, NULL); }
 
+void re_thread_yield(void) { sched_yield(); }
+
 // Mutexes
 re_mutex_t *re_mutex_create(void) {
-    re_mutex_t *mutex = re_malloc(sizeof(re_mutex_t));
+    return re_mutex_create_alloc(re_heap_allocator());
+}
+
+re_mutex_t *re_mutex_create_alloc(re_allocator_t allocator) {
+    re_mutex_t *mutex = re_allocator_alloc(allocator, sizeof(re_mutex_t));
     mutex->handle = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+    mutex->allocator = allocator;
     return mutex;
 }
 
 void re_mutex_destroy(re_mutex_t *mutex) {
     pthread_mutex_destroy(&mutex->handle);
-    re_free(mutex);
+    re_allocator_free(mutex->allocator, mutex, sizeof(re_mutex_t));
 }
 
 void re_mutex_lock(re_mutex_t *mutex) { pthread_mutex_lock(&mutex->handle); }
@@ -1262,6 +3344,12 @@ f32_t re_os_get_time(void) {
     return ((f32_t)tp.tv_sec + (f32_t)tp.tv_nsec * 1e-9) - _re_os_state.start_time;
 }
 
+u64_t re_os_get_time_ns(void) {
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (u64_t) tp.tv_sec * 1000000000ull + tp.tv_nsec;
+}
+
 u32_t re_os_get_processor_count(void) {
     return _re_os_state.processor_count;
 }
@@ -1270,12 +3358,51 @@ u32_t re_os_get_page_size(void) {
     return _re_os_state.page_size;
 }
 
+u32_t re_os_get_huge_page_size(void) {
+    return _re_os_state.huge_page_size;
+}
+
 /*=========================*/
 // Memory
 /*=========================*/
 
 void *re_os_mem_reserve(usize_t size) {
-    return mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0);
+    void *ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr != MAP_FAILED ? ptr : NULL;
+}
+
+void *re_os_mem_reserve_huge(usize_t size, re_os_huge_pages_t huge_pages) {
+    usize_t huge_page_size = re_os_get_huge_page_size();
+
+    switch (huge_pages) {
+        case RE_OS_HUGE_PAGES_NONE:
+            break;
+        case RE_OS_HUGE_PAGES_EXPLICIT: {
+            // Without MAP_NORESERVE the kernel reserves the pages up front,
+            // failing here rather than with SIGBUS on first touch.
+            void *ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            return ptr != MAP_FAILED ? ptr : NULL;
+        }
+        case RE_OS_HUGE_PAGES_TRANSPARENT: {
+            // Over reserve and trim so the range starts on a huge page boundary.
+            ptr_t ptr = mmap(NULL, size + huge_page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED) {
+                return NULL;
+            }
+            ptr_t aligned = (ptr_t) re_align_up(re_ptr_to_usize(ptr), huge_page_size);
+            if (aligned != ptr) {
+                munmap(ptr, aligned - ptr);
+            }
+            munmap(aligned + size, huge_page_size - (aligned - ptr));
+
+            // Advisory only, the kernel may have transparent huge pages disabled.
+            madvise(aligned, size, MADV_HUGEPAGE);
+            return aligned;
+        }
+    }
+
+    void *ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr != MAP_FAILED ? ptr : NULL;
 }
 
 void re_os_mem_commit(void *ptr, usize_t size) {
@@ -1283,6 +3410,20 @@ void re_os_mem_commit(void *ptr, usize_t size) {
 }
 
 void re_os_mem_decommit(void *ptr, usize_t size) {
+    // mprotect alone leaves the pages resident, drop them first.
+    madvise(ptr, size, MADV_DONTNEED);
+    mprotect(ptr, size, PROT_NONE);
+}
+
+void re_os_mem_decommit_lazy(void *ptr, usize_t size) {
+#ifdef MADV_FREE
+    // MADV_FREE isn't supported on every mapping type (e.g. hugetlbfs).
+    if (madvise(ptr, size, MADV_FREE) != 0) {
+        madvise(ptr, size, MADV_DONTNEED);
+    }
+#else
+    madvise(ptr, size, MADV_DONTNEED);
+#endif
     mprotect(ptr, size, PROT_NONE);
 }
 
@@ -1290,170 +3431,72 @@ void re_os_mem_release(void *ptr, usize_t size) {
     munmap(ptr, size);
 }
 
-#endif // RE_OS_LINUX
-
-#ifdef RE_OS_WINDOWS
-#endif
-
-#ifdef RE_UNIT_TESTS
-
-void re_dyn_arr_unit_test(void) {
-    re_dyn_arr_t(i32_t) arr = NULL;
-    i32_t data[8] = {0, 1, 2, 3, 4, 5, 6, 7};
-
-    {
-        i32_t expected[8] = {0, 1, 2, 3, 4, 5, 6, 7};
-
-        for (u32_t i = 0; i < 8; i++) {
-            re_dyn_arr_push(arr, i);
-        }
-
-        RE_ENSURE(re_dyn_arr_count(arr) == 8, "re_dyn_arr_count not matching.");
-        RE_ENSURE(memcmp(arr, expected, sizeof(expected)) == 0, "Array's don't match.");
-
-        re_dyn_arr_free(arr);
-
-        RE_ENSURE(arr == NULL, "Dynamic array not freed properly.");
-    }
-
-    {
-        i32_t expected[8] = {7, 6, 5, 4, 3, 2, 1, 0};
-
-        for (u32_t i = 0; i < 8; i++) {
-            re_dyn_arr_insert(arr, i, 0);
-        }
-
-        RE_ENSURE(re_dyn_arr_count(arr) == 8, "re_dyn_arr_count not matching.");
-        RE_ENSURE(memcmp(arr, expected, sizeof(expected)) == 0, "Array's don't match.");
-
-        re_dyn_arr_free(arr);
+u64_t re_os_mem_huge_page_bytes(void *ptr, usize_t size) {
+    FILE *fp = fopen("/proc/self/smaps", "r");
+    if (fp == NULL) {
+        return 0;
     }
 
-    {
-        i32_t expected[8] = {7, 0, 1, 2, 3, 4, 5, 6};
-
-        for (u32_t i = 0; i < 8; i++) {
-            re_dyn_arr_insert_fast(arr, i, 0);
+    usize_t range_start = re_ptr_to_usize(ptr);
+    usize_t range_end = range_start + size;
+
+    u64_t result = 0;
+    usize_t overlap = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        usize_t start, end;
+        u64_t kb;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            // Mapping header, measure how much of it lies within the range.
+            usize_t overlap_start = re_max(start, range_start);
+            usize_t overlap_end = re_min(end, range_end);
+            overlap = overlap_start < overlap_end ? overlap_end - overlap_start : 0;
+        } else if (overlap != 0 &&
+                   (sscanf(line, "AnonHugePages: %llu kB", &kb) == 1 ||
+                    sscanf(line, "Private_Hugetlb: %llu kB", &kb) == 1 ||
+                    sscanf(line, "Shared_Hugetlb: %llu kB", &kb) == 1)) {
+            // Adjacent mappings may have been merged with the range, never
+            // count more than the overlap.
+            u64_t bytes = KB(kb);
+            result += re_min(bytes, overlap);
         }
-
-        RE_ENSURE(re_dyn_arr_count(arr) == 8, "re_dyn_arr_count not matching.");
-        RE_ENSURE(memcmp(arr, expected, sizeof(expected)) == 0, "Array's don't match.");
-
-        re_dyn_arr_free(arr);
-    }
-
-    {
-        i32_t expected[8] = {4, 5, 6, 7, 0, 1, 2, 3};
-
-        re_dyn_arr_push_arr(arr, &data[4], 4);
-        re_dyn_arr_push_arr(arr, data, 4);
-
-        RE_ENSURE(re_dyn_arr_count(arr) == 8, "re_dyn_arr_count not matching.");
-        RE_ENSURE(memcmp(arr, expected, sizeof(expected)) == 0, "Array's don't match.");
-
-        re_dyn_arr_free(arr);
-    }
-
-    {
-        i32_t expected[8] = {0, 4, 5, 6, 7, 1, 2, 3};
-
-        re_dyn_arr_insert_arr(arr, data, 4, 0);
-        re_dyn_arr_insert_arr(arr, &data[4], 4, 1);
-
-        RE_ENSURE(re_dyn_arr_count(arr) == 8, "re_dyn_arr_count not matching.");
-        RE_ENSURE(memcmp(arr, expected, sizeof(expected)) == 0, "Array's don't match.");
-
-        re_dyn_arr_free(arr);
-    }
-
-    {
-        i32_t expected[4] = {0, 0, 0, 0};
-
-        re_dyn_arr_reserve(arr, 4);
-
-        RE_ENSURE(re_dyn_arr_count(arr) == 4, "re_dyn_arr_count not matching.");
-        RE_ENSURE(memcmp(arr, expected, sizeof(expected)) == 0, "Array's don't match.");
-
-        re_dyn_arr_free(arr);
-    }
-
-    {
-        re_dyn_arr_push_arr(arr, data, 8);
-
-        i32_t expected_value = 7;
-        i32_t expected_arr[7] = {0, 1, 2, 3, 4, 5, 6};
-
-        i32_t value = re_dyn_arr_pop(arr);
-
-        RE_ENSURE(re_dyn_arr_count(arr) == 7, "re_dyn_arr_count not matching.");
-        RE_ENSURE(value == expected_value, "Value not matching.");
-        RE_ENSURE(memcmp(arr, expected_arr, sizeof(expected_arr)) == 0, "Array's don't match.");
-
-        re_dyn_arr_free(arr);
     }
 
-    {
-        re_dyn_arr_push_arr(arr, data, 8);
-
-        i32_t expected_value = 1;
-        i32_t expected_arr[7] = {0, 2, 3, 4, 5, 6, 7};
-
-        i32_t value = re_dyn_arr_remove(arr, 1);
-
-        RE_ENSURE(re_dyn_arr_count(arr) == 7, "re_dyn_arr_count not matching.");
-        RE_ENSURE(value == expected_value, "Value not matching.");
-        RE_ENSURE(memcmp(arr, expected_arr, sizeof(expected_arr)) == 0, "Array's don't match.");
+    fclose(fp);
+    return result;
+}
 
-        re_dyn_arr_free(arr);
+const void *re_os_file_map(const char *filepath, usize_t *size) {
+    i32_t fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
     }
 
-    {
-        re_dyn_arr_push_arr(arr, data, 8);
-
-        i32_t expected_value = 1;
-        i32_t expected_arr[7] = {0, 7, 2, 3, 4, 5, 6};
-
-        i32_t value = re_dyn_arr_remove_fast(arr, 1);
-
-        RE_ENSURE(re_dyn_arr_count(arr) == 7, "re_dyn_arr_count not matching.");
-        RE_ENSURE(value == expected_value, "Value not matching.");
-        RE_ENSURE(memcmp(arr, expected_arr, sizeof(expected_arr)) == 0, "Array's don't match.");
-
-        re_dyn_arr_free(arr);
+    struct stat info;
+    void *ptr = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        ptr = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
     }
-
-    {
-        re_dyn_arr_push_arr(arr, data, 8);
-
-        i32_t expected_result_arr[4] = {4, 5, 6, 7};
-        i32_t expected_arr[4] = {0, 1, 2, 3};
-
-        i32_t result_arr[4] = {0};
-        re_dyn_arr_pop_arr(arr, 4, result_arr);
-
-        RE_ENSURE(re_dyn_arr_count(arr) == 4, "re_dyn_arr_count not matching.");
-        RE_ENSURE(memcmp(result_arr, expected_result_arr, sizeof(expected_result_arr)) == 0, "Value not matching.");
-        RE_ENSURE(memcmp(arr, expected_arr, sizeof(expected_arr)) == 0, "Array's don't match.");
-
-        re_dyn_arr_free(arr);
+    // The mapping keeps the file alive on its own.
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return NULL;
     }
 
-    {
-        re_dyn_arr_push_arr(arr, data, 8);
+    *size = info.st_size;
+    return ptr;
+}
 
-        i32_t expected_result_arr[4] = {0, 1, 2, 3};
-        i32_t expected_arr[4] = {4, 5, 6, 7};
+void re_os_file_unmap(const void *ptr, usize_t size) {
+    munmap((void *) ptr, size);
+}
 
-        i32_t result_arr[4] = {0};
-        re_dyn_arr_remove_arr(arr, 4, 0, result_arr);
+#endif // RE_OS_LINUX
 
-        RE_ENSURE(re_dyn_arr_count(arr) == 4, "re_dyn_arr_count not matching.");
-        RE_ENSURE(memcmp(result_arr, expected_result_arr, sizeof(expected_result_arr)) == 0, "Value not matching.");
-        RE_ENSURE(memcmp(arr, expected_arr, sizeof(expected_arr)) == 0, "Array's don't match.");
+#ifdef RE_OS_WINDOWS
+#endif
 
-        re_dyn_arr_free(arr);
-    }
-}
+#ifdef RE_UNIT_TESTS
 
 static u64_t iter_hash(const void *a, u32_t size) {
     (void) size;
@@ -1464,6 +3507,22 @@ static u64_t iter_hash(const void *a, u32_t size) {
 void re_hash_map_unit_test(void) {
     re_hash_map_t(i32_t, const char *) re_hash_map = NULL;
 
+    {
+        u8_t data[128];
+        for (u32_t i = 0; i < re_arr_len(data); i++) {
+            data[i] = i;
+        }
+        u64_t high_bits = 0;
+        for (u32_t size = 0; size < re_arr_len(data); size++) {
+            u64_t hash = re_wyhash(data, size);
+            high_bits |= hash >> 32;
+            RE_ENSURE(hash == re_wyhash_seeded(data, size, 0), "re_wyhash isn't deterministic.");
+            RE_ENSURE(hash != re_wyhash_seeded(data, size, 1), "re_wyhash ignores the seed.");
+            RE_ENSURE(size == 0 || hash != re_wyhash(data, size - 1), "re_wyhash ignores the size.");
+        }
+        RE_ENSURE(high_bits != 0, "re_wyhash doesn't produce 64-bit hashes.");
+    }
+
     {
         re_hash_map_set(re_hash_map, 42, "foo");
         const char *value = re_hash_map_get(re_hash_map, 42);
@@ -1479,17 +3538,18 @@ void re_hash_map_unit_test(void) {
 
     {
         re_hash_map_set(re_hash_map, 42, "foo");
-        i32_t index = 7;
+        i32_t index = re_hash_map_iter_get(re_hash_map);
+        i32_t empty_index = (index + 1) % re_hash_map->base.table.capacity;
 
         const char *value = re_hash_map_get_index_value(re_hash_map, index);
-        RE_ENSURE(strcmp(value, "foo") == 0, "Value at index 7 doesn't match.");
+        RE_ENSURE(strcmp(value, "foo") == 0, "Value at index %d doesn't match.", index);
         i32_t key = re_hash_map_get_index_key(re_hash_map, index);
-        RE_ENSURE(key == 42, "Key at index 7 doesn't match.");
+        RE_ENSURE(key == 42, "Key at index %d doesn't match.", index);
 
-        value = re_hash_map_get_index_value(re_hash_map, 0);
-        RE_ENSURE(value == NULL, "Value at index 0 not expected.");
-        key = re_hash_map_get_index_key(re_hash_map, 0);
-        RE_ENSURE(key == 0, "Key at index 0 not expected.");
+        value = re_hash_map_get_index_value(re_hash_map, empty_index);
+        RE_ENSURE(value == NULL, "Value at index %d not expected.", empty_index);
+        key = re_hash_map_get_index_key(re_hash_map, empty_index);
+        RE_ENSURE(key == 0, "Key at index %d not expected.", empty_index);
     }
 
     {
@@ -1515,6 +3575,19 @@ void re_hash_map_unit_test(void) {
         re_hash_map_free(iter_map);
     }
 
+    {
+        re_tracking_allocator_t tracker = {.parent = re_heap_allocator()};
+        re_hash_map_t(i32_t, i32_t) tracked_map = NULL;
+        re_hash_map_init_alloc(tracked_map, 0, 0, re_wyhash, _re_hash_map_default_equal_func, re_tracking_allocator(&tracker));
+        for (i32_t i = 0; i < 100; i++) {
+            re_hash_map_set(tracked_map, i, i);
+        }
+        RE_ENSURE(tracker.bytes > 0 && tracker.peak_bytes >= tracker.bytes, "Tracking allocator not used.");
+        re_hash_map_free(tracked_map);
+        RE_ENSURE(tracker.bytes == 0, "Hash map leaked %llu bytes.", tracker.bytes);
+        RE_ENSURE(tracker.alloc_count == tracker.free_count, "Hash map allocations and frees don't match.");
+    }
+
     re_hash_map_free(re_hash_map);
     RE_ENSURE(re_hash_map == NULL, "Hash map not freed properly.");
 }
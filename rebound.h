@@ -111,7 +111,30 @@ typedef u8_t *ptr_t;
 // Initialization
 /*=========================*/
 
+#ifndef RE_SCRATCH_POOL_MAX
+#define RE_SCRATCH_POOL_MAX 8
+#endif
+
+typedef struct re_config_t re_config_t;
+struct re_config_t {
+    // Scratch arenas available per thread, at most RE_SCRATCH_POOL_MAX.
+    // Zero selects 2.
+    u32_t scratch_pool_size;
+    // Bytes reserved per scratch arena. Zero selects 8 GB.
+    u64_t scratch_capacity;
+    // re_arena_flags_t for scratch arenas, combined with RE_SCRATCH_ARENA_FLAGS.
+    u32_t scratch_flags;
+    // Hand the scratch arenas of exiting threads to other threads instead of
+    // releasing them. See re_arena_scratch_recycle.
+    b8_t scratch_recycle;
+    // Seed used by re_wyhash. Set it to a random value to make hash maps
+    // resistant to collision attacks on untrusted keys.
+    u64_t hash_seed;
+};
+
+// Initializes with the default configuration.
 RE_API void re_init(void);
+RE_API void re_init_config(re_config_t config);
 RE_API void re_terminate(void);
 
 /*=========================*/
@@ -127,6 +150,7 @@ RE_API void re_terminate(void);
 #ifndef RE_MALLOC
 #include <stdlib.h>
 #define RE_MALLOC malloc
+#define RE_CALLOC calloc
 #define RE_REALLOC realloc
 #define RE_FREE free
 #endif
@@ -134,26 +158,167 @@ RE_API void re_terminate(void);
 #define OUT_OF_MEMORY "Out of memory"
 
 RE_API void *re_malloc(usize_t size);
+// Allocates zeroed memory. Uses RE_CALLOC when defined, otherwise clears
+// an RE_MALLOC allocation.
+RE_API void *re_calloc(usize_t count, usize_t size);
 RE_API void *re_realloc(void *ptr, usize_t size);
 RE_API void  re_free(void *ptr);
 
+// Allocator interface used by containers.
+typedef struct re_allocator_t re_allocator_t;
+struct re_allocator_t {
+    // Allocates 'size' bytes aligned for any type.
+    void *(*alloc)(usize_t size, void *ctx);
+    // Resizes an allocation from 'old_size' to 'new_size' bytes, moving it if needed.
+    void *(*resize)(void *ptr, usize_t old_size, usize_t new_size, void *ctx);
+    // Frees an allocation of 'size' bytes.
+    void (*free)(void *ptr, usize_t size, void *ctx);
+    // Optional, allocates 'size' zeroed bytes. Lets allocators backed by
+    // fresh pages skip clearing memory the kernel already zeroed.
+    void *(*alloc_zeroed)(usize_t size, void *ctx);
+    void *ctx;
+};
+
+#define re_allocator_alloc(ALLOCATOR, SIZE) \
+    (ALLOCATOR).alloc((SIZE), (ALLOCATOR).ctx)
+#define re_allocator_resize(ALLOCATOR, PTR, OLD_SIZE, NEW_SIZE) \
+    (ALLOCATOR).resize((PTR), (OLD_SIZE), (NEW_SIZE), (ALLOCATOR).ctx)
+#define re_allocator_free(ALLOCATOR, PTR, SIZE) \
+    (ALLOCATOR).free((PTR), (SIZE), (ALLOCATOR).ctx)
+
+// Allocates 'size' zeroed bytes, clearing an ordinary allocation when the
+// allocator has no alloc_zeroed.
+RE_API void *re_allocator_alloc_zeroed(re_allocator_t allocator, usize_t size);
+
+// Allocator using re_malloc, re_calloc, re_realloc and re_free.
+RE_API re_allocator_t re_heap_allocator(void);
+
+// Wraps another allocator and keeps count of its usage. Not thread safe.
+typedef struct re_tracking_allocator_t re_tracking_allocator_t;
+struct re_tracking_allocator_t {
+    re_allocator_t parent;
+    // Bytes currently allocated.
+    u64_t bytes;
+    u64_t peak_bytes;
+    u64_t alloc_count;
+    u64_t resize_count;
+    u64_t free_count;
+};
+
+// Allocator recording usage in 'tracker', which must outlive it.
+RE_API re_allocator_t re_tracking_allocator(re_tracking_allocator_t *tracker);
+
 /*=========================*/
 // Arena
 /*=========================*/
 
+#ifndef RE_ARENA_DEFAULT_COMMIT_SIZE
+#define RE_ARENA_DEFAULT_COMMIT_SIZE KB(64)
+#endif
+
+#ifndef RE_SCRATCH_ARENA_FLAGS
+#define RE_SCRATCH_ARENA_FLAGS 0
+#endif
+
 typedef struct re_arena_t re_arena_t;
 
+typedef enum {
+    // Back the arena with transparent huge pages.
+    RE_ARENA_FLAG_HUGE_PAGES          = 1 << 0,
+    // Back the arena with explicit huge pages from the hugetlbfs pool.
+    // Falls back to transparent huge pages if the pool can't hold the reservation.
+    RE_ARENA_FLAG_HUGE_PAGES_EXPLICIT = 1 << 1,
+    // Decommit with MADV_FREE, letting the kernel reclaim pages only under
+    // memory pressure instead of dropping them right away.
+    RE_ARENA_FLAG_LAZY_DECOMMIT       = 1 << 2,
+    // Track usage statistics, see re_arena_get_stats.
+    // Defining RE_ARENA_STATS enables this for every arena, including scratch arenas.
+    RE_ARENA_FLAG_STATS               = 1 << 3,
+    // Link a new block when the reservation runs out instead of aborting.
+    // Each block reserves 'capacity' bytes, or more for bigger pushes.
+    RE_ARENA_FLAG_CHAINED             = 1 << 4,
+} re_arena_flags_t;
+
+typedef struct re_arena_desc_t re_arena_desc_t;
+struct re_arena_desc_t {
+    // Bytes of virtual memory to reserve.
+    // Chained arenas reserve this much per block.
+    u64_t capacity;
+    // Granularity of memory commits, rounded up to a multiple of the page size.
+    // Zero selects RE_ARENA_DEFAULT_COMMIT_SIZE.
+    // Huge page arenas round this up to the huge page size.
+    u64_t commit_size;
+    // Bytes kept committed and resident when popping or clearing, so
+    // frame style arenas don't fault the same pages in every cycle.
+    // Rounded up to the commit size.
+    u64_t retain_size;
+    // Combination of re_arena_flags_t.
+    u32_t flags;
+    // Name shown when dumping the arena registry. Must outlive the arena.
+    const char *name;
+};
+
+typedef struct re_arena_stats_t re_arena_stats_t;
+struct re_arena_stats_t {
+    const char *name;
+    u64_t capacity;
+    u64_t position;
+    u64_t commited;
+    // Fields below are only tracked by arenas with RE_ARENA_FLAG_STATS.
+    u64_t peak_position;
+    u64_t peak_commited;
+    u64_t commit_count;
+    u64_t decommit_count;
+    u64_t push_count;
+    u64_t push_bytes;
+};
+
+typedef void (*re_arena_stats_callback_t)(const re_arena_stats_t *stats, void *user_data);
+
+// Creates an arena reserving 'capacity' bytes with the default commit size.
 RE_API re_arena_t *re_arena_create(u64_t capacity);
+// Creates an arena from a description.
+RE_API re_arena_t *re_arena_create_desc(re_arena_desc_t desc);
 RE_API void re_arena_destroy(re_arena_t **arena);
 
 RE_API void *re_arena_push(re_arena_t *arena, u64_t size);
 RE_API void *re_arena_push_zero(re_arena_t *arena, u64_t size);
+// Pushes 'size' bytes starting at an address that is a multiple of 'alignment'.
+// 'alignment' must be a power of two.
+RE_API void *re_arena_push_aligned(re_arena_t *arena, u64_t size, u64_t alignment);
+RE_API void *re_arena_push_aligned_zero(re_arena_t *arena, u64_t size, u64_t alignment);
+
+// Pushes a correctly aligned T.
+#define re_arena_push_struct(ARENA, T) \
+    ((T *) re_arena_push_aligned((ARENA), sizeof(T), _Alignof(T)))
+#define re_arena_push_struct_zero(ARENA, T) \
+    ((T *) re_arena_push_aligned_zero((ARENA), sizeof(T), _Alignof(T)))
+// Pushes a correctly aligned array of COUNT T.
+#define re_arena_push_array(ARENA, T, COUNT) \
+    ((T *) re_arena_push_aligned((ARENA), sizeof(T) * (COUNT), _Alignof(T)))
+#define re_arena_push_array_zero(ARENA, T, COUNT) \
+    ((T *) re_arena_push_aligned_zero((ARENA), sizeof(T) * (COUNT), _Alignof(T)))
 
 RE_API void re_arena_pop(re_arena_t *arena, u64_t size);
 RE_API void re_arena_clear(re_arena_t *arena);
 
+// Allocator pushing to 'arena'. Resizing or freeing the last allocation
+// happens in place, anything else is left for re_arena_clear.
+RE_API re_allocator_t re_arena_allocator(re_arena_t *arena);
+
 RE_API u64_t re_arena_get_pos(re_arena_t *arena);
 RE_API void *re_arena_get_index(u64_t index, re_arena_t *arena);
+// Retrieves the arena usage statistics.
+RE_API re_arena_stats_t re_arena_get_stats(re_arena_t *arena);
+// Calls 'callback' with the statistics of every live arena, including the
+// scratch arenas of all threads. Other threads' arenas are read without
+// synchronization so their numbers may be slightly stale.
+RE_API void re_arena_registry_iter(re_arena_stats_callback_t callback, void *user_data);
+// Writes the statistics of every live arena to 'fp'.
+RE_API void re_arena_registry_dump(FILE *fp);
+// Number of committed bytes currently backed by huge pages.
+// Reads /proc/self/smaps, so avoid calling it in hot paths.
+RE_API u64_t re_arena_get_huge_page_bytes(re_arena_t *arena);
 
 // Temp
 typedef struct re_arena_temp_t re_arena_temp_t;
@@ -166,11 +331,34 @@ RE_API re_arena_temp_t re_arena_temp_start(re_arena_t *arena);
 RE_API void re_arena_temp_end(re_arena_temp_t *arena);
 
 // Scratch
+// Scratch arenas are created lazily, one at a time, the first time a thread needs them.
 RE_API re_arena_temp_t re_arena_scratch_get(re_arena_t **conflicts, u32_t conflict_count);
 #define re_arena_scratch_release(scratch) re_arena_temp_end(scratch)
+// Clears the calling thread's scratch arenas and hands them over to other
+// threads, which reuse them before reserving new ones.
+RE_API void re_arena_scratch_recycle(void);
 
 RE_API void _re_arena_scratch_destroy(void);
 
+// Shared
+// Arena safe to push to from many threads at once.
+// Pushes advance the position with an atomic fetch-add, threads needing more
+// memory committed coordinate through compare-and-swap.
+typedef struct re_shared_arena_t re_shared_arena_t;
+
+RE_API re_shared_arena_t *re_shared_arena_create(u64_t capacity);
+// Creates a shared arena from a description. Chained arenas aren't supported.
+RE_API re_shared_arena_t *re_shared_arena_create_desc(re_arena_desc_t desc);
+RE_API void re_shared_arena_destroy(re_shared_arena_t **arena);
+
+RE_API void *re_shared_arena_push(re_shared_arena_t *arena, u64_t size);
+RE_API void *re_shared_arena_push_zero(re_shared_arena_t *arena, u64_t size);
+RE_API void *re_shared_arena_push_aligned(re_shared_arena_t *arena, u64_t size, u64_t alignment);
+
+// Resets the arena. Not thread safe, no other thread may push meanwhile.
+RE_API void re_shared_arena_clear(re_shared_arena_t *arena);
+RE_API u64_t re_shared_arena_get_pos(re_shared_arena_t *arena);
+
 /*=========================*/
 // Utils
 /*=========================*/
@@ -210,15 +398,15 @@ typedef b8_t (*re_equal_func_t)(const void *a, const void *b, u32_t size);
 #define _re_concat(A, B) A##B
 
 // Clamps V between MIN and MAX.
-#define re_clamp(V, MIN, MAX) (V) > (MAX) ? (MAX) : (V) < (MIN) ? (MIN) : (V)
+#define re_clamp(V, MIN, MAX) ((V) > (MAX) ? (MAX) : (V) < (MIN) ? (MIN) : (V))
 // Clamps V maximum value to MAX.
-#define re_clamp_max(V, MAX) (V) > (MAX) ? (MAX) : (V)
+#define re_clamp_max(V, MAX) ((V) > (MAX) ? (MAX) : (V))
 // Clamps V minimum value to MIN.
-#define re_clamp_min(V, MIN) (V) < (MIN) ? (MIN) : (V)
+#define re_clamp_min(V, MIN) ((V) < (MIN) ? (MIN) : (V))
 // Returns the biggest value of A and B.
-#define re_max(A, B) (A) > (B) ? (A) : (B)
+#define re_max(A, B) ((A) > (B) ? (A) : (B))
 // Returns the smallest value of A and B.
-#define re_min(A, B) (A) < (B) ? (A) : (B)
+#define re_min(A, B) ((A) < (B) ? (A) : (B))
 
 // Converts a pointer to an integer.
 #define re_ptr_to_usize(PTR) ((usize_t) ((u8_t *) (PTR) - (u8_t) 0))
@@ -228,6 +416,8 @@ typedef b8_t (*re_equal_func_t)(const void *a, const void *b, u32_t size);
 #define re_offsetof(S, M) re_ptr_to_usize(&((S *) 0)->M)
 // Calculates the length of ARR.
 #define re_arr_len(ARR) (sizeof(ARR) / sizeof(ARR[0]))
+// Rounds N up to a multiple of ALIGN. ALIGN must be a power of two.
+#define re_align_up(N, ALIGN) (((N) + ((ALIGN) - 1)) & ~((__typeof__(N)) (ALIGN) - 1))
 
 #define U8_MAX    ((u8_t) ~0)
 #define U16_MAX   ((u16_t) ~0)
@@ -263,6 +453,10 @@ typedef b8_t (*re_equal_func_t)(const void *a, const void *b, u32_t size);
 
 // Hashes data using the fvn1a algorithm.
 RE_API u64_t re_fvn1a_hash(const void *data, u64_t size);
+// Hashes data using the wyhash algorithm, consuming up to 48 bytes per step.
+// Uses the hash seed from re_config_t.
+RE_API u64_t re_wyhash(const void *data, u64_t size);
+RE_API u64_t re_wyhash_seeded(const void *data, u64_t size, u64_t seed);
 // Formats the fmt string into the provided buffer.
 RE_API void re_format_string(char buffer[1024], const char *fmt, ...) RE_FORMAT_FUNCTION(2, 3);
 
@@ -290,6 +484,9 @@ RE_API i32_t    re_str_cmp(re_str_t a, re_str_t b);
 RE_API re_str_t re_str_pushf(const char *fmt, va_list args, re_arena_t *arena);
 RE_API re_str_t re_str_push_copy(re_str_t str, re_arena_t *arena);
 RE_API re_str_t re_str_concat(re_str_t a, re_str_t b, re_arena_t *arena);
+// Hash and equal functions over the contents of re_str_t keys.
+RE_API u64_t re_str_hash(const void *str, u64_t size);
+RE_API b8_t  re_str_equal(const void *a, const void *b, u32_t size);
 
 typedef struct re_str_list_t re_str_list_t;
 struct re_str_list_t {
@@ -376,20 +573,58 @@ RE_API re_str_t re_str_list_concat(re_str_list_t *list, re_arena_t *arena);
 
 #define re_dyn_arr_t(T) T *
 
+// Capacity multiplier once an array is full. 1.5 wastes less memory, 2
+// reallocates less often.
+#ifndef RE_DYN_ARR_GROWTH_FACTOR
+#define RE_DYN_ARR_GROWTH_FACTOR 2.0f
+#endif
+
+// Stored right before the first element, public so the common paths can be
+// expanded inline.
+typedef struct re_dyn_arr_head_t re_dyn_arr_head_t;
+struct re_dyn_arr_head_t {
+    re_allocator_t allocator;
+    u32_t capacity;
+    u32_t count;
+    u32_t size;
+};
+
+#define _re_dyn_arr_head(ARR) ((re_dyn_arr_head_t *) ((ptr_t) (ARR) - sizeof(re_dyn_arr_head_t)))
+
 #define re_dyn_arr_new(ARR, SIZE) \
-    _re_dyn_arr_new_impl((void **) &(ARR), (SIZE))
+    ((ARR) == NULL ? _re_dyn_arr_new_impl((void **) &(ARR), (SIZE)) : (void) 0)
+
+// Creates the array with memory from ALLOCATOR instead of the heap.
+#define re_dyn_arr_new_alloc(ARR, ALLOCATOR) \
+    _re_dyn_arr_new_alloc_impl((void **) &(ARR), sizeof(*(ARR)), (ALLOCATOR))
+
+// Creates the array inside ARENA. The last allocation of an arena grows in
+// place. Arena arrays don't need to be freed, re_arena_clear releases them.
+#define re_dyn_arr_new_arena(ARR, ARENA) \
+    re_dyn_arr_new_alloc((ARR), re_arena_allocator(ARENA))
 
 #define re_dyn_arr_free(ARR) \
     _re_dyn_arr_free_impl((void **) &(ARR))
 
-u32_t re_dyn_arr_count(void *arr);
-u32_t re_dyn_arr_size(void *arr);
+#define re_dyn_arr_count(ARR) ((ARR) != NULL ? _re_dyn_arr_head(ARR)->count : 0)
+#define re_dyn_arr_size(ARR) ((ARR) != NULL ? _re_dyn_arr_head(ARR)->size : 0)
+#define re_dyn_arr_capacity(ARR) ((ARR) != NULL ? _re_dyn_arr_head(ARR)->capacity : 0)
 
 #define re_dyn_arr_last(ARR) ((ARR)[re_dyn_arr_count(ARR) - 1])
 
 // Iterations
-#define re_dyn_arr_push(ARR, VALUE) \
-    re_dyn_arr_insert_fast((ARR), (VALUE), re_dyn_arr_count(ARR))
+
+// Appends VALUE, only calling out of line when the array has to be created
+// or grown.
+#define re_dyn_arr_push(ARR, VALUE) ({ \
+        __typeof__(*(ARR)) temp_value = (VALUE); \
+        if (__builtin_expect((ARR) == NULL || _re_dyn_arr_head(ARR)->count == _re_dyn_arr_head(ARR)->capacity, 0)) { \
+            _re_dyn_arr_grow_impl((void **) &(ARR), sizeof(*(ARR))); \
+        } \
+        re_dyn_arr_head_t *temp_head = _re_dyn_arr_head(ARR); \
+        (ARR)[temp_head->count] = temp_value; \
+        temp_head->count++; \
+    })
 
 #define re_dyn_arr_insert(ARR, VALUE, INDEX) ({ \
         re_dyn_arr_new((ARR), sizeof(__typeof__(*(ARR)))); \
@@ -417,6 +652,10 @@ u32_t re_dyn_arr_size(void *arr);
 #define re_dyn_arr_reserve(ARR, COUNT) \
     re_dyn_arr_push_arr((ARR), NULL, (COUNT))
 
+// Releases the capacity beyond the current count.
+#define re_dyn_arr_shrink_to_fit(ARR) \
+    _re_dyn_arr_shrink_to_fit_impl((void **) &(ARR))
+
 // Removal
 #define re_dyn_arr_pop(ARR) \
     re_dyn_arr_remove_fast((ARR), re_dyn_arr_count(ARR) - 1)
@@ -442,7 +681,11 @@ u32_t re_dyn_arr_size(void *arr);
 
 // Private API
 RE_API void _re_dyn_arr_new_impl(void **arr, u32_t size);
+RE_API void _re_dyn_arr_new_alloc_impl(void **arr, u32_t size, re_allocator_t allocator);
 RE_API void _re_dyn_arr_free_impl(void **arr);
+// Makes room for one more element, creating the array if it's NULL.
+RE_API void _re_dyn_arr_grow_impl(void **arr, u32_t size);
+RE_API void _re_dyn_arr_shrink_to_fit_impl(void **arr);
 RE_API void _re_dyn_arr_insert_fast_impl(void **arr, const void *value, u32_t index);
 RE_API void _re_dyn_arr_insert_arr_impl(void **arr, const void *value_arr, u32_t count, u32_t index);
 RE_API void _re_dyn_arr_remove_fast_impl(void **arr, u32_t index, void *result);
@@ -452,128 +695,280 @@ RE_API void _re_dyn_arr_remove_arr_impl(void **arr, u32_t count, u32_t index, vo
 // Hash map
 /*=========================*/
 
+// The hash map is a typed handle around a type erased core. Keys and values
+// are stored by value in buckets and compared bytewise unless an equal
+// function is provided.
+
+#define _RE_HASH_MAP_MAX_LOAD 0.75f
+#define _RE_HASH_MAP_GROW_FACTOR 2
+#define _RE_HASH_MAP_MAX_TOMBSTONE_LOAD 0.25f
+
+typedef enum {
+    BUCKET_STATE_INACTIVE,
+    BUCKET_STATE_IN_USE,
+    BUCKET_STATE_TOMBSTONE
+} bucket_state_t;
+
+typedef enum {
+    // Linear probing one bucket at a time.
+    RE_HASH_MAP_ENGINE_LINEAR,
+    // Swiss table probing. A separate control byte per bucket holds 7 bits
+    // of the hash so 16 buckets are checked per compare without touching
+    // keys or values.
+    RE_HASH_MAP_ENGINE_SWISS,
+    // Robin Hood linear probing. Buckets are kept ordered by probe distance
+    // and removal shifts the following buckets back, so there are never any
+    // tombstones or rebuilds after removal.
+    RE_HASH_MAP_ENGINE_ROBIN_HOOD,
+
+    RE_HASH_MAP_ENGINE_COUNT
+} re_hash_map_engine_t;
+
+typedef enum {
+    // Spread resizing over many operations instead of rehashing everything
+    // in one set. The old buckets are kept and RE_HASH_MAP_MIGRATE_BUCKETS of
+    // them are moved per set or remove, while lookups check both. Ignored by
+    // RE_HASH_MAP_ENGINE_ROBIN_HOOD, where moving a key found by a lookup
+    // would shift other buckets and invalidate pointers to their values.
+    RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE = 1 << 0,
+    // Keep hashes, states, keys and values in separate arrays instead of
+    // interleaving them per bucket, so probing streams only hashes and keys.
+    // Pays off for small keys with big values.
+    RE_HASH_MAP_FLAG_SOA = 1 << 1,
+} re_hash_map_flags_t;
+
+// Set by re_str_map_init, the only way to create a map with a key arena.
+#define _RE_HASH_MAP_FLAG_STR_KEYS (1u << 31)
+
+// Old buckets migrated per set or remove during an incremental resize.
+#ifndef RE_HASH_MAP_MIGRATE_BUCKETS
+#define RE_HASH_MAP_MIGRATE_BUCKETS 64
+#endif
+
+typedef struct re_hash_map_desc_t re_hash_map_desc_t;
+struct re_hash_map_desc_t {
+    re_hash_map_engine_t engine;
+    // re_hash_map_flags_t
+    u32_t flags;
+    // Entries to make room for up front.
+    u32_t capacity;
+    // NULL selects re_wyhash.
+    re_hash_func_t hash_func;
+    // NULL selects a bytewise comparison.
+    re_equal_func_t equal_func;
+    // Zeroed selects re_heap_allocator.
+    re_allocator_t allocator;
+    // Keys are re_str_t whose bytes are copied into this arena when they're
+    // first inserted, so the map doesn't borrow the caller's strings. Only
+    // set through re_str_map_init.
+    re_arena_t *key_arena;
+};
+
+typedef struct _re_hash_table_t _re_hash_table_t;
+struct _re_hash_table_t {
+    u8_t *buckets;
+    // Swiss control bytes, capacity plus a mirror of the first group.
+    u8_t *ctrl;
+    // Always a power of two so buckets are found with a mask.
+    u32_t capacity;
+    u32_t mask;
+    u32_t tombstone_count;
+    // Offsets of the first hash, state, key and value in buckets.
+    usize_t hash_base;
+    usize_t state_base;
+    usize_t key_base;
+    usize_t value_base;
+    usize_t size;
+};
+
+typedef struct _re_hash_map_t _re_hash_map_t;
+struct _re_hash_map_t {
+    re_hash_map_engine_t engine;
+    u32_t flags;
+    // Size of the typed handle wrapping this.
+    u32_t handle_size;
+    u32_t count;
+
+    // Bucket layout. Every field is found at its base in the table plus
+    // the index times its stride. Interleaved buckets are hash, state, key,
+    // value, each bucket_size bytes.
+    u32_t key_size;
+    u32_t key_align;
+    u32_t value_size;
+    u32_t value_align;
+    u32_t key_offset;
+    u32_t value_offset;
+    u32_t bucket_size;
+    u32_t hash_stride;
+    u32_t state_stride;
+    u32_t key_stride;
+    u32_t value_stride;
+    _re_hash_table_t table;
+    // Buckets left to migrate by an incremental resize, from migrate_index.
+    _re_hash_table_t old_table;
+    u32_t migrate_index;
+
+    void *null_key;
+    void *null_value;
+    re_hash_func_t hash_func;
+    re_equal_func_t equal_func;
+    re_allocator_t allocator;
+    re_arena_t *key_arena;
+    // File mapping holding the buckets of a loaded snapshot, NULL otherwise.
+    void *snapshot;
+    usize_t snapshot_size;
+};
+
 #define re_hash_map_t(KEY, VALUE) struct { \
-    struct { \
-        KEY key; \
-        VALUE value; \
-        u64_t hash; \
-        bucket_state_t state; \
-    } *buckets; \
-    u32_t count; \
-    u32_t tombstone_count; \
-    void *null_value; \
-    void *null_key; \
-    re_hash_func_t hash_func; \
-    re_equal_func_t equal_func; \
+    _re_hash_map_t base; \
+    KEY *key_type; \
+    VALUE *value_type; \
 } *
 
-#define re_hash_map_init(MAP, NULL_KEY, NULL_VALUE, HASH_FUNC, EQUAL_FUNC) ({ \
+#define _re_hash_map_key_t(MAP) __typeof__(*(MAP)->key_type)
+#define _re_hash_map_value_t(MAP) __typeof__(*(MAP)->value_type)
+
+#define _re_hash_map_key_ptr(MAP, INDEX) \
+    ((void *) ((MAP)->table.buckets + (MAP)->table.key_base + (usize_t) (INDEX) * (MAP)->key_stride))
+#define _re_hash_map_value_ptr(MAP, INDEX) \
+    ((void *) ((MAP)->table.buckets + (MAP)->table.value_base + (usize_t) (INDEX) * (MAP)->value_stride))
+
+#define re_hash_map_init_desc(MAP, NULL_KEY, NULL_VALUE, DESC) ({ \
         if ((MAP) == NULL) { \
-            (MAP) = re_malloc(sizeof(*(MAP))); \
-            *(MAP) = (__typeof__(*(MAP))) {0}; \
-            re_dyn_arr_reserve((MAP)->buckets, 8); \
-            (MAP)->count = 0; \
-            \
-            __typeof__(NULL_KEY) temp_null_key = (NULL_KEY); \
-            (MAP)->null_key = re_malloc(sizeof(__typeof__((MAP)->buckets->key))); \
-            memcpy((MAP)->null_key, &temp_null_key, sizeof(__typeof__((MAP)->buckets->key))); \
-            \
-            __typeof__(NULL_VALUE) temp_null_value = (NULL_VALUE); \
-            (MAP)->null_value = re_malloc(sizeof(__typeof__((MAP)->buckets->value))); \
-            memcpy((MAP)->null_value, &temp_null_value, sizeof(__typeof__((MAP)->buckets->value))); \
-            \
-            (MAP)->hash_func = (HASH_FUNC); \
-            (MAP)->equal_func = (EQUAL_FUNC); \
+            _re_hash_map_key_t(MAP) temp_null_key = (NULL_KEY); \
+            _re_hash_map_value_t(MAP) temp_null_value = (NULL_VALUE); \
+            _re_hash_map_init_impl((void **) &(MAP), sizeof(*(MAP)), \
+                    sizeof(temp_null_key), _Alignof(_re_hash_map_key_t(MAP)), \
+                    sizeof(temp_null_value), _Alignof(_re_hash_map_value_t(MAP)), \
+                    &temp_null_key, &temp_null_value, (DESC)); \
         } \
     })
 
-#define re_hash_map_init_default(MAP) \
-    re_hash_map_init((MAP), ((__typeof__((MAP)->buckets->key)) {0}), ((__typeof__((MAP)->buckets->value)) {0}), (re_hash_func_t) (void *) re_fvn1a_hash, _re_hash_map_default_equal_func)
+#define re_hash_map_init(MAP, NULL_KEY, NULL_VALUE, HASH_FUNC, EQUAL_FUNC) \
+    re_hash_map_init_desc((MAP), (NULL_KEY), (NULL_VALUE), ((re_hash_map_desc_t) { \
+            .hash_func = (HASH_FUNC), \
+            .equal_func = (EQUAL_FUNC) \
+        }))
 
-#define re_hash_map_free(MAP) ({ \
-        if ((MAP) != NULL) { \
-            re_dyn_arr_free((MAP)->buckets); \
-            re_free((MAP)->null_key); \
-            re_free((MAP)->null_value); \
-            re_free(MAP); \
-            (MAP) = NULL; \
-        } \
+// Initializes the map with all of its memory coming from ALLOCATOR.
+#define re_hash_map_init_alloc(MAP, NULL_KEY, NULL_VALUE, HASH_FUNC, EQUAL_FUNC, ALLOCATOR) \
+    re_hash_map_init_desc((MAP), (NULL_KEY), (NULL_VALUE), ((re_hash_map_desc_t) { \
+            .hash_func = (HASH_FUNC), \
+            .equal_func = (EQUAL_FUNC), \
+            .allocator = (ALLOCATOR) \
+        }))
+
+#define re_hash_map_init_default(MAP) \
+    re_hash_map_init_desc((MAP), ((_re_hash_map_key_t(MAP)) {0}), ((_re_hash_map_value_t(MAP)) {0}), ((re_hash_map_desc_t) {0}))
+
+// String keyed map. Keys are hashed and compared by content, so lookups can
+// use any borrowed re_str_t without allocating. If ARENA isn't NULL, keys are
+// copied into it on insertion. Must be initialized before use.
+#define re_str_map_t(VALUE) re_hash_map_t(re_str_t, VALUE)
+#define re_str_map_init(MAP, ARENA) \
+    re_hash_map_init_desc((MAP), re_str_null, ((_re_hash_map_value_t(MAP)) {0}), ((re_hash_map_desc_t) { \
+            .hash_func = re_str_hash, \
+            .equal_func = re_str_equal, \
+            .flags = _RE_HASH_MAP_FLAG_STR_KEYS, \
+            .key_arena = (ARENA) \
+        }))
+
+// Initializes the map with room for CAPACITY entries before it has to grow.
+#define re_hash_map_init_capacity(MAP, CAPACITY) \
+    re_hash_map_init_desc((MAP), ((_re_hash_map_key_t(MAP)) {0}), ((_re_hash_map_value_t(MAP)) {0}), ((re_hash_map_desc_t) {.capacity = (CAPACITY)}))
+
+#define re_hash_map_free(MAP) _re_hash_map_free_impl((void **) &(MAP))
+
+// Makes room for COUNT entries in total without growing.
+#define re_hash_map_reserve(MAP, COUNT) ({ \
+        re_hash_map_init_default(MAP); \
+        _re_hash_map_reserve_impl(&(MAP)->base, (COUNT)); \
     })
 
-#define re_hash_map_count(MAP) ((MAP)->count)
+#define re_hash_map_count(MAP) ((MAP)->base.count)
 
 #define re_hash_map_set(MAP, KEY, VALUE) ({ \
         re_hash_map_init_default(MAP); \
-        /* Resize if needed. */ \
-        if ((MAP)->count >= re_dyn_arr_count((MAP)->buckets) * _RE_HASH_MAP_MAX_LOAD) { \
-            __typeof__((MAP)->buckets) new_buckets = NULL; \
-            re_dyn_arr_reserve(new_buckets, re_dyn_arr_count((MAP)->buckets) * _RE_HASH_MAP_GROW_FACTOR); \
-            for (u32_t i = 0; i < re_dyn_arr_count((MAP)->buckets); i++) { \
-                if ((MAP)->buckets[i].state == BUCKET_STATE_IN_USE) { \
-                    b8_t _temp; (void) _temp; \
-                    u32_t index = _re_hash_map_find_bucket(new_buckets, &(MAP)->buckets[i].key, (MAP)->buckets[i].hash, (MAP)->equal_func, _temp); \
-                    new_buckets[index] = (MAP)->buckets[i]; \
-                } \
-            } \
-            re_dyn_arr_free((MAP)->buckets); \
-            (MAP)->buckets = new_buckets; \
-        } \
-        \
-        __typeof__((MAP)->buckets->key) temp_key = (KEY); \
-        u64_t hash = (MAP)->hash_func(&temp_key, sizeof((MAP)->buckets->key)); \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        _re_hash_map_value_t(MAP) temp_value = (VALUE); \
         b8_t new_entry; \
-        u32_t index = _re_hash_map_find_bucket((MAP)->buckets, &temp_key, hash, (MAP)->equal_func, new_entry); \
-        (MAP)->buckets[index].key = temp_key; \
-        (MAP)->buckets[index].value = (VALUE); \
-        (MAP)->buckets[index].hash = hash; \
-        (MAP)->buckets[index].state = BUCKET_STATE_IN_USE; \
-        if (new_entry) { \
-            (MAP)->count++; \
-        } \
+        u32_t index = _re_hash_map_insert_impl(&(MAP)->base, &temp_key, &new_entry); \
+        *(_re_hash_map_value_t(MAP) *) _re_hash_map_value_ptr(&(MAP)->base, index) = temp_value; \
+    })
+
+// Sets COUNT entries from the KEYS and VALUES arrays, reserving room for
+// all of them once instead of checking for growth on every insert.
+#define re_hash_map_set_arr(MAP, KEYS, VALUES, COUNT) ({ \
+        re_hash_map_init_default(MAP); \
+        const _re_hash_map_key_t(MAP) *temp_keys = (KEYS); \
+        const _re_hash_map_value_t(MAP) *temp_values = (VALUES); \
+        _re_hash_map_set_arr_impl(&(MAP)->base, temp_keys, temp_values, (COUNT)); \
     })
 
 #define re_hash_map_get(MAP, KEY) ({ \
         re_hash_map_init_default(MAP); \
-        __typeof__((MAP)->buckets->value) result; \
-        __typeof__((MAP)->buckets->key) temp_key = (KEY); \
-        u64_t hash = (MAP)->hash_func(&temp_key, sizeof(temp_key)); \
-        b8_t temp; (void) temp; \
-        i32_t index = _re_hash_map_find_bucket((MAP)->buckets, &temp_key, hash, (MAP)->equal_func, temp); \
-        if ((MAP)->buckets[index].state == BUCKET_STATE_IN_USE) { \
-            result = (MAP)->buckets[index].value; \
-        } else { \
-            memcpy(&result, (MAP)->null_value, sizeof(__typeof__((MAP)->buckets->value))); \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        u32_t index = _re_hash_map_find_impl(&(MAP)->base, &temp_key); \
+        _re_hash_map_value_t(MAP) *result = (MAP)->base.null_value; \
+        if (index != U32_MAX) { \
+            result = _re_hash_map_value_ptr(&(MAP)->base, index); \
+        } \
+        *result; \
+    })
+
+// Returns a pointer to the value of KEY or NULL, found with a single probe.
+// The pointer is valid until the map is modified. Lookups during an
+// incremental resize move keys without touching other buckets, so they
+// don't invalidate it.
+#define re_hash_map_get_ptr(MAP, KEY) ({ \
+        re_hash_map_init_default(MAP); \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        u32_t index = _re_hash_map_find_impl(&(MAP)->base, &temp_key); \
+        _re_hash_map_value_t(MAP) *result = NULL; \
+        if (index != U32_MAX) { \
+            result = _re_hash_map_value_ptr(&(MAP)->base, index); \
         } \
         result; \
     })
 
+// Returns a pointer to the value of KEY, inserting KEY with the null value
+// if it's missing, so it can be updated in place with a single probe. The
+// pointer is valid until the map is modified.
+#define re_hash_map_get_or_insert_ptr(MAP, KEY) ({ \
+        re_hash_map_init_default(MAP); \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        b8_t new_entry; \
+        u32_t index = _re_hash_map_insert_impl(&(MAP)->base, &temp_key, &new_entry); \
+        _re_hash_map_value_t(MAP) *result = _re_hash_map_value_ptr(&(MAP)->base, index); \
+        if (new_entry) { \
+            memcpy(result, (MAP)->base.null_value, sizeof(*result)); \
+        } \
+        result; \
+    })
 
 #define re_hash_map_get_index_key(MAP, INDEX) ({ \
         re_hash_map_init_default(MAP); \
-        __typeof__((MAP)->buckets->key) result; \
-        if ((MAP)->buckets[(INDEX)].state == BUCKET_STATE_IN_USE) { \
-            result = (MAP)->buckets[(INDEX)].key; \
-        } else { \
-            memcpy(&result, (MAP)->null_key, sizeof(__typeof__((MAP)->buckets->key))); \
+        _re_hash_map_key_t(MAP) *result = (MAP)->base.null_key; \
+        if (_re_hash_map_index_valid_impl(&(MAP)->base, (INDEX))) { \
+            result = _re_hash_map_key_ptr(&(MAP)->base, (INDEX)); \
         } \
-        result; \
+        *result; \
     })
 
 #define re_hash_map_get_index_value(MAP, INDEX) ({ \
         re_hash_map_init_default(MAP); \
-        __typeof__((MAP)->buckets->value) result; \
-        if ((MAP)->buckets[(INDEX)].state == BUCKET_STATE_IN_USE) { \
-            result = (MAP)->buckets[(INDEX)].value; \
-        } else { \
-            memcpy(&result, (MAP)->null_value, sizeof(__typeof__((MAP)->buckets->value))); \
+        _re_hash_map_value_t(MAP) *result = (MAP)->base.null_value; \
+        if (_re_hash_map_index_valid_impl(&(MAP)->base, (INDEX))) { \
+            result = _re_hash_map_value_ptr(&(MAP)->base, (INDEX)); \
         } \
-        result; \
+        *result; \
     })
+
 #define re_hash_map_get_index_value_ptr(MAP, INDEX) ({ \
         re_hash_map_init_default(MAP); \
-        __typeof__((MAP)->buckets->value) *result = NULL; \
-        if ((MAP)->buckets[(INDEX)].state == BUCKET_STATE_IN_USE) { \
-            result = &(MAP)->buckets[(INDEX)].value; \
+        _re_hash_map_value_t(MAP) *result = NULL; \
+        if (_re_hash_map_index_valid_impl(&(MAP)->base, (INDEX))) { \
+            result = _re_hash_map_value_ptr(&(MAP)->base, (INDEX)); \
         } \
         result; \
     })
@@ -581,64 +976,56 @@ RE_API void _re_dyn_arr_remove_arr_impl(void **arr, u32_t count, u32_t index, vo
 #define re_hash_map_has(MAP, KEY) ({ \
         b8_t result = false; \
         if ((MAP) != NULL) { \
-            __typeof__((MAP)->buckets->key) temp_key = (KEY); \
-            u64_t hash = (MAP)->hash_func(&temp_key, sizeof(temp_key)); \
-            b8_t temp; (void) temp; \
-            i32_t index = _re_hash_map_find_bucket((MAP)->buckets, &temp_key, hash, (MAP)->equal_func, temp); \
-            result = (MAP)->buckets[index].state == BUCKET_STATE_IN_USE; \
+            _re_hash_map_key_t(MAP) temp_key = (KEY); \
+            result = _re_hash_map_find_impl(&(MAP)->base, &temp_key) != U32_MAX; \
         } \
         result; \
     })
 
 #define re_hash_map_remove(MAP, KEY) ({ \
         re_hash_map_init_default(MAP); \
-        __typeof__((MAP)->buckets->value) result; \
-        __typeof__((MAP)->buckets->key) temp_key = (KEY); \
-        u64_t hash = (MAP)->hash_func(&temp_key, sizeof(temp_key)); \
-        b8_t temp; (void) temp; \
-        i32_t index = _re_hash_map_find_bucket((MAP)->buckets, &temp_key, hash, (MAP)->equal_func, temp); \
-        if ((MAP)->buckets[index].state == BUCKET_STATE_IN_USE) { \
-            result = (MAP)->buckets[index].value; \
-            (MAP)->buckets[index].state = BUCKET_STATE_TOMBSTONE; \
-            (MAP)->count--; \
-            (MAP)->tombstone_count++; \
-        } else { \
-            memcpy(&result, (MAP)->null_value, sizeof((MAP)->buckets->value)); \
-        } \
-        /* Redo bucket array to get rid of tombstones. */ \
-        if ((MAP)->tombstone_count >= re_dyn_arr_count((MAP)->buckets) * _RE_HASH_MAP_MAX_TOMBSTONE_LOAD) { \
-            __typeof__((MAP)->buckets) new_buckets = NULL; \
-            re_dyn_arr_reserve(new_buckets, re_dyn_arr_count((MAP)->buckets)); \
-            for (u32_t i = 0; i < re_dyn_arr_count((MAP)->buckets); i++) { \
-                if ((MAP)->buckets[i].state == BUCKET_STATE_IN_USE) { \
-                    b8_t _temp; (void) _temp; \
-                    u32_t index = _re_hash_map_find_bucket(new_buckets, &(MAP)->buckets[i].key, (MAP)->buckets[i].hash, (MAP)->equal_func, _temp); \
-                    new_buckets[index] = (MAP)->buckets[i]; \
-                } \
-            } \
-            re_dyn_arr_free((MAP)->buckets); \
-            (MAP)->buckets = new_buckets; \
-            (MAP)->tombstone_count = 0; \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        _re_hash_map_value_t(MAP) result; \
+        if (!_re_hash_map_remove_impl(&(MAP)->base, &temp_key, &result)) { \
+            result = *(_re_hash_map_value_t(MAP) *) (MAP)->base.null_value; \
         } \
         result; \
     })
 
-#define _re_hash_map_find_bucket(BUCKETS, KEY, HASH, EQUAL_FUNC, NEW_ENTRY) ({ \
-        u32_t index = (HASH) % re_dyn_arr_count((BUCKETS)); \
-        (NEW_ENTRY) = true; \
-        while (true) { \
-            if ((BUCKETS)[index].state == BUCKET_STATE_INACTIVE) { \
-                break; \
-            } else if ((BUCKETS)[index].hash == (HASH) && \
-                       (EQUAL_FUNC)((KEY), &(BUCKETS)[index].key, sizeof((BUCKETS)->key))) { \
-                (NEW_ENTRY) = false; \
-                break; \
-           } \
-           index = (index + 1) % re_dyn_arr_count((BUCKETS)); \
-        } \
-        index; \
+// Snapshots
+//
+// A snapshot is the bucket array written to a file as is. Loading maps the
+// file read-only and uses its buckets directly, so a map is ready after a
+// single mmap and pages come in as lookups touch them. Keys and values have
+// to be plain data without pointers, and the map has to be loaded with the
+// hash and equal functions it was saved with. Snapshots only work on the
+// machine architecture that made them. Inserting into or removing from a
+// loaded map is an error, and pointers from re_hash_map_get_ptr must not be
+// written through.
+
+// Returns false if the file can't be written.
+#define re_hash_map_save(MAP, FILEPATH) ({ \
+        re_hash_map_init_default(MAP); \
+        _re_hash_map_save_impl(&(MAP)->base, (FILEPATH)); \
+    })
+
+// Loads a snapshot into an uninitialized MAP. The engine and layout come
+// from the file, DESC supplies the functions and the allocator for the
+// handle. Returns false and leaves MAP NULL if the file can't be mapped or
+// doesn't hold a snapshot of a map with these key and value types.
+#define re_hash_map_load(MAP, FILEPATH, NULL_KEY, NULL_VALUE, DESC) ({ \
+        RE_ASSERT((MAP) == NULL, "Snapshots can only be loaded into an uninitialized hash map."); \
+        _re_hash_map_key_t(MAP) temp_null_key = (NULL_KEY); \
+        _re_hash_map_value_t(MAP) temp_null_value = (NULL_VALUE); \
+        _re_hash_map_load_impl((void **) &(MAP), sizeof(*(MAP)), \
+                sizeof(temp_null_key), _Alignof(_re_hash_map_key_t(MAP)), \
+                sizeof(temp_null_value), _Alignof(_re_hash_map_value_t(MAP)), \
+                &temp_null_key, &temp_null_value, (FILEPATH), (DESC)); \
     })
 
+#define re_hash_map_load_default(MAP, FILEPATH) \
+    re_hash_map_load((MAP), (FILEPATH), ((_re_hash_map_key_t(MAP)) {0}), ((_re_hash_map_value_t(MAP)) {0}), ((re_hash_map_desc_t) {0}))
+
 // Iteration
 typedef u32_t re_hash_map_iter_t;
 
@@ -649,28 +1036,418 @@ typedef u32_t re_hash_map_iter_t;
 
 #define re_hash_map_iter_next(MAP, ITER) ({ \
         re_hash_map_init_default(MAP); \
-        u32_t result = U32_MAX; \
-        for (u32_t i = (ITER) + 1; i < re_dyn_arr_count((MAP)->buckets); i++) { \
-            if ((MAP)->buckets[i].state == BUCKET_STATE_IN_USE) { \
-                result = i; \
-                break; \
-            } \
+        _re_hash_map_next_impl(&(MAP)->base, (ITER)); \
+    })
+
+RE_API b8_t _re_hash_map_default_equal_func(const void *a, const void *b, u32_t size);
+
+RE_API void _re_hash_map_init_impl(void **map, u32_t map_size, u32_t key_size, u32_t key_align, u32_t value_size, u32_t value_align, const void *null_key, const void *null_value, re_hash_map_desc_t desc);
+RE_API void _re_hash_map_free_impl(void **map);
+// Returns the bucket index of key or U32_MAX. Moves the key over if it's
+// still in the old buckets of an incremental resize.
+RE_API u32_t _re_hash_map_find_impl(_re_hash_map_t *map, const void *key);
+// Returns the bucket index of key, claiming and writing the key to a new
+// bucket if it isn't in the map. The value is left for the caller to write.
+RE_API u32_t _re_hash_map_insert_impl(_re_hash_map_t *map, const void *key, b8_t *new_entry);
+RE_API void _re_hash_map_reserve_impl(_re_hash_map_t *map, u32_t count);
+RE_API void _re_hash_map_set_arr_impl(_re_hash_map_t *map, const void *keys, const void *values, u32_t count);
+// Copies the removed value to value if it isn't NULL.
+RE_API b8_t _re_hash_map_remove_impl(_re_hash_map_t *map, const void *key, void *value);
+RE_API b8_t _re_hash_map_save_impl(_re_hash_map_t *map, const char *filepath);
+RE_API b8_t _re_hash_map_load_impl(void **map, u32_t map_size, u32_t key_size, u32_t key_align, u32_t value_size, u32_t value_align, const void *null_key, const void *null_value, const char *filepath, re_hash_map_desc_t desc);
+RE_API b8_t _re_hash_map_index_valid_impl(const _re_hash_map_t *map, u32_t index);
+// Returns the next bucket in use after index or U32_MAX. Finishes any
+// incremental resize first so every entry is visited.
+RE_API u32_t _re_hash_map_next_impl(_re_hash_map_t *map, u32_t index);
+
+// Hash set
+//
+// Hash map without values, running on the same engines. Buckets only hold
+// the hash, state and key.
+
+#define re_hash_set_t(KEY) struct { \
+    _re_hash_map_t base; \
+    KEY *key_type; \
+} *
+
+#define re_hash_set_init_desc(SET, NULL_KEY, DESC) ({ \
+        if ((SET) == NULL) { \
+            _re_hash_map_key_t(SET) temp_null_key = (NULL_KEY); \
+            _re_hash_map_init_impl((void **) &(SET), sizeof(*(SET)), \
+                    sizeof(temp_null_key), _Alignof(_re_hash_map_key_t(SET)), \
+                    0, 1, &temp_null_key, NULL, (DESC)); \
+        } \
+    })
+
+#define re_hash_set_init_default(SET) \
+    re_hash_set_init_desc((SET), ((_re_hash_map_key_t(SET)) {0}), ((re_hash_map_desc_t) {0}))
+
+#define re_hash_set_free(SET) _re_hash_map_free_impl((void **) &(SET))
+
+#define re_hash_set_reserve(SET, COUNT) ({ \
+        re_hash_set_init_default(SET); \
+        _re_hash_map_reserve_impl(&(SET)->base, (COUNT)); \
+    })
+
+#define re_hash_set_count(SET) ((SET)->base.count)
+
+// Returns true if KEY wasn't in the set yet.
+#define re_hash_set_insert(SET, KEY) ({ \
+        re_hash_set_init_default(SET); \
+        _re_hash_map_key_t(SET) temp_key = (KEY); \
+        b8_t new_entry; \
+        _re_hash_map_insert_impl(&(SET)->base, &temp_key, &new_entry); \
+        new_entry; \
+    })
+
+#define re_hash_set_has(SET, KEY) re_hash_map_has((SET), (KEY))
+
+// Returns true if KEY was in the set.
+#define re_hash_set_remove(SET, KEY) ({ \
+        re_hash_set_init_default(SET); \
+        _re_hash_map_key_t(SET) temp_key = (KEY); \
+        _re_hash_map_remove_impl(&(SET)->base, &temp_key, NULL); \
+    })
+
+// Adds every key of SRC to DST.
+#define re_hash_set_union(DST, SRC) ({ \
+        re_hash_set_init_default(DST); \
+        (void) sizeof((DST)->key_type == (SRC)->key_type); \
+        if ((SRC) != NULL) { \
+            _re_hash_set_union_impl(&(DST)->base, &(SRC)->base); \
+        } \
+    })
+
+// Removes every key of DST that isn't in SRC.
+#define re_hash_set_intersect(DST, SRC) ({ \
+        re_hash_set_init_default(DST); \
+        (void) sizeof((DST)->key_type == (SRC)->key_type); \
+        _re_hash_set_intersect_impl(&(DST)->base, (SRC) != NULL ? &(SRC)->base : NULL); \
+    })
+
+#define re_hash_set_get_index_key(SET, INDEX) ({ \
+        re_hash_set_init_default(SET); \
+        _re_hash_map_key_t(SET) *result = (SET)->base.null_key; \
+        if (_re_hash_map_index_valid_impl(&(SET)->base, (INDEX))) { \
+            result = _re_hash_map_key_ptr(&(SET)->base, (INDEX)); \
+        } \
+        *result; \
+    })
+
+#define re_hash_set_iter_get(SET) re_hash_set_iter_next(SET, -1)
+#define re_hash_set_iter_valid(ITER) re_hash_map_iter_valid(ITER)
+#define re_hash_set_iter_next(SET, ITER) ({ \
+        re_hash_set_init_default(SET); \
+        _re_hash_map_next_impl(&(SET)->base, (ITER)); \
+    })
+
+RE_API void _re_hash_set_union_impl(_re_hash_map_t *dst, _re_hash_map_t *src);
+// A NULL src empties dst.
+RE_API void _re_hash_set_intersect_impl(_re_hash_map_t *dst, _re_hash_map_t *src);
+
+// Frozen hash map
+//
+// Read-only copy of a hash map built around a minimal perfect hash function
+// (hash and displace). Keys and values sit in dense arrays with no empty
+// buckets, and every bucket of the hash picks a displacement that sends
+// its keys to distinct slots. A lookup hashes the key once, mixes the hash
+// with its bucket's displacement to get the slot and compares one key.
+// The hash covers 5% more slots than keys to keep building fast, keys on
+// those spare slots are remapped to the holes left in the arrays.
+
+typedef struct _re_frozen_map_t _re_frozen_map_t;
+struct _re_frozen_map_t {
+    u32_t handle_size;
+    u32_t count;
+    u32_t key_size;
+    u32_t value_size;
+    u32_t bucket_count;
+    u32_t slot_count;
+    // One displacement per bucket, then the array index of every spare
+    // slot, the keys and the values.
+    u32_t *displacements;
+    u32_t *remap;
+    u8_t *keys;
+    u8_t *values;
+    usize_t data_size;
+    void *null_value;
+    re_hash_func_t hash_func;
+    re_equal_func_t equal_func;
+    re_allocator_t allocator;
+};
+
+#define re_frozen_map_t(KEY, VALUE) struct { \
+    _re_frozen_map_t base; \
+    KEY *key_type; \
+    VALUE *value_type; \
+} *
+
+// Builds FROZEN from the entries of MAP, using its hash and equal functions
+// and allocator. FROZEN must be NULL. Returns false, leaving FROZEN NULL, if
+// two different keys have the same full 64 bit hash, which no displacement
+// can separate, or if a bucket tried all _RE_FROZEN_MAP_MAX_DISPLACEMENT
+// displacements without finding free slots.
+#define re_hash_map_freeze(MAP, FROZEN) ({ \
+        RE_ASSERT((FROZEN) == NULL, "Can only freeze into an uninitialized frozen map."); \
+        (void) sizeof((MAP)->key_type == (FROZEN)->key_type); \
+        (void) sizeof((MAP)->value_type == (FROZEN)->value_type); \
+        re_hash_map_init_default(MAP); \
+        _re_frozen_map_init_impl((void **) &(FROZEN), sizeof(*(FROZEN)), &(MAP)->base); \
+    })
+
+#define re_frozen_map_free(MAP) _re_frozen_map_free_impl((void **) &(MAP))
+
+#define re_frozen_map_count(MAP) ((MAP)->base.count)
+
+#define re_frozen_map_get(MAP, KEY) ({ \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        u32_t index = _re_frozen_map_find_impl(&(MAP)->base, &temp_key); \
+        _re_hash_map_value_t(MAP) *result = (MAP)->base.null_value; \
+        if (index != U32_MAX) { \
+            result = &re_frozen_map_values(MAP)[index]; \
+        } \
+        *result; \
+    })
+
+#define re_frozen_map_get_ptr(MAP, KEY) ({ \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        u32_t index = _re_frozen_map_find_impl(&(MAP)->base, &temp_key); \
+        _re_hash_map_value_t(MAP) *result = NULL; \
+        if (index != U32_MAX) { \
+            result = &re_frozen_map_values(MAP)[index]; \
         } \
         result; \
     })
 
+#define re_frozen_map_has(MAP, KEY) ({ \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        _re_frozen_map_find_impl(&(MAP)->base, &temp_key) != U32_MAX; \
+    })
 
-#define _RE_HASH_MAP_MAX_LOAD 0.75f
-#define _RE_HASH_MAP_GROW_FACTOR 2
-#define _RE_HASH_MAP_MAX_TOMBSTONE_LOAD 0.25f
+// Dense arrays of re_frozen_map_count keys and values, matched by index.
+#define re_frozen_map_keys(MAP) ((_re_hash_map_key_t(MAP) *) (MAP)->base.keys)
+#define re_frozen_map_values(MAP) ((_re_hash_map_value_t(MAP) *) (MAP)->base.values)
+
+RE_API b8_t _re_frozen_map_init_impl(void **map, u32_t map_size, _re_hash_map_t *src);
+RE_API void _re_frozen_map_free_impl(void **map);
+// Returns the index of key in the dense arrays or U32_MAX.
+RE_API u32_t _re_frozen_map_find_impl(const _re_frozen_map_t *map, const void *key);
+
+// Shared hash map
+//
+// Hash map safe to use from many threads at once. Entries are spread over
+// shards by hash, each shard being a hash map with its own lock, so threads
+// only contend when they touch the same shard. Values are copied in and out
+// under the lock. Has to be initialized before it's shared between threads.
+
+// Shards created per processor, rounded up to a power of two.
+#ifndef RE_SHARED_HASH_MAP_SHARDS_PER_CORE
+#define RE_SHARED_HASH_MAP_SHARDS_PER_CORE 4
+#endif
 
-typedef enum {
-    BUCKET_STATE_INACTIVE,
-    BUCKET_STATE_IN_USE,
-    BUCKET_STATE_TOMBSTONE
-} bucket_state_t;
+typedef struct _re_hash_map_shard_t _re_hash_map_shard_t;
 
-RE_API b8_t _re_hash_map_default_equal_func(const void *a, const void *b, u32_t size);
+typedef struct _re_shared_hash_map_t _re_shared_hash_map_t;
+struct _re_shared_hash_map_t {
+    u32_t handle_size;
+    u32_t shard_mask;
+    _re_hash_map_shard_t *shards;
+    void *shards_allocation;
+    re_hash_func_t hash_func;
+    re_allocator_t allocator;
+};
+
+#define re_shared_hash_map_t(KEY, VALUE) struct { \
+    _re_shared_hash_map_t base; \
+    KEY *key_type; \
+    VALUE *value_type; \
+} *
+
+// DESC is applied to every shard, with the capacity split between them.
+// Shards allocate from different threads at once, so DESC can't have a key
+// arena and its allocator must be zeroed or re_heap_allocator.
+#define re_shared_hash_map_init(MAP, NULL_KEY, NULL_VALUE, DESC) ({ \
+        _re_hash_map_key_t(MAP) temp_null_key = (NULL_KEY); \
+        _re_hash_map_value_t(MAP) temp_null_value = (NULL_VALUE); \
+        _re_shared_hash_map_init_impl((void **) &(MAP), sizeof(*(MAP)), \
+                sizeof(temp_null_key), _Alignof(_re_hash_map_key_t(MAP)), \
+                sizeof(temp_null_value), _Alignof(_re_hash_map_value_t(MAP)), \
+                &temp_null_key, &temp_null_value, (DESC)); \
+    })
+
+#define re_shared_hash_map_init_default(MAP) \
+    re_shared_hash_map_init((MAP), ((_re_hash_map_key_t(MAP)) {0}), ((_re_hash_map_value_t(MAP)) {0}), ((re_hash_map_desc_t) {0}))
+
+#define re_shared_hash_map_free(MAP) _re_shared_hash_map_free_impl((void **) &(MAP))
+
+#define re_shared_hash_map_set(MAP, KEY, VALUE) ({ \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        _re_hash_map_value_t(MAP) temp_value = (VALUE); \
+        _re_shared_hash_map_set_impl(&(MAP)->base, &temp_key, &temp_value); \
+    })
+
+#define re_shared_hash_map_get(MAP, KEY) ({ \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        _re_hash_map_value_t(MAP) result; \
+        _re_shared_hash_map_get_impl(&(MAP)->base, &temp_key, &result); \
+        result; \
+    })
+
+#define re_shared_hash_map_has(MAP, KEY) ({ \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        _re_shared_hash_map_get_impl(&(MAP)->base, &temp_key, NULL); \
+    })
+
+#define re_shared_hash_map_remove(MAP, KEY) ({ \
+        _re_hash_map_key_t(MAP) temp_key = (KEY); \
+        _re_hash_map_value_t(MAP) result; \
+        _re_shared_hash_map_remove_impl(&(MAP)->base, &temp_key, &result); \
+        result; \
+    })
+
+// Entry count at some point during the call.
+#define re_shared_hash_map_count(MAP) _re_shared_hash_map_count_impl(&(MAP)->base)
+
+RE_API void _re_shared_hash_map_init_impl(void **map, u32_t map_size, u32_t key_size, u32_t key_align, u32_t value_size, u32_t value_align, const void *null_key, const void *null_value, re_hash_map_desc_t desc);
+RE_API void _re_shared_hash_map_free_impl(void **map);
+RE_API void _re_shared_hash_map_set_impl(_re_shared_hash_map_t *map, const void *key, const void *value);
+// Copies the value, or the null value if key isn't found, to value if it
+// isn't NULL.
+RE_API b8_t _re_shared_hash_map_get_impl(_re_shared_hash_map_t *map, const void *key, void *value);
+RE_API b8_t _re_shared_hash_map_remove_impl(_re_shared_hash_map_t *map, const void *key, void *value);
+RE_API u32_t _re_shared_hash_map_count_impl(_re_shared_hash_map_t *map);
+
+// Index map
+//
+// Hash map keeping its entries densely in insertion order in a dynamic array,
+// with the probe table holding only entry indices. Iterating walks just the
+// live entries, in a deterministic order. Removal moves the last entry into
+// the hole, so it stays O(1) but changes that entry's position.
+
+typedef struct _re_index_map_slot_t _re_index_map_slot_t;
+
+typedef struct _re_index_map_t _re_index_map_t;
+struct _re_index_map_t {
+    u32_t handle_size;
+    u32_t key_size;
+    u32_t value_size;
+    u32_t value_offset;
+    // Dynamic array of entries, each a key followed by a value.
+    void *entries;
+    // Null key and value, laid out like an entry.
+    void *null_entry;
+    _re_index_map_slot_t *slots;
+    u32_t capacity;
+    u32_t mask;
+    re_hash_func_t hash_func;
+    re_equal_func_t equal_func;
+    re_allocator_t allocator;
+};
+
+#define re_index_map_t(KEY, VALUE) struct { \
+    _re_index_map_t base; \
+    struct { \
+        KEY key; \
+        VALUE value; \
+    } *entry_type; \
+} *
+
+#define _re_index_map_entry_t(MAP) __typeof__(*(MAP)->entry_type)
+#define _re_index_map_key_t(MAP) __typeof__((MAP)->entry_type->key)
+#define _re_index_map_value_t(MAP) __typeof__((MAP)->entry_type->value)
+
+// Only the capacity, the hash and equal functions and the allocator of DESC
+// are used.
+#define re_index_map_init_desc(MAP, NULL_KEY, NULL_VALUE, DESC) ({ \
+        if ((MAP) == NULL) { \
+            _re_index_map_entry_t(MAP) temp_null_entry = {(NULL_KEY), (NULL_VALUE)}; \
+            _re_index_map_init_impl((void **) &(MAP), sizeof(*(MAP)), \
+                    sizeof(temp_null_entry.key), sizeof(temp_null_entry.value), \
+                    __builtin_offsetof(_re_index_map_entry_t(MAP), value), sizeof(temp_null_entry), \
+                    &temp_null_entry, (DESC)); \
+        } \
+    })
+
+#define re_index_map_init_default(MAP) \
+    re_index_map_init_desc((MAP), ((_re_index_map_key_t(MAP)) {0}), ((_re_index_map_value_t(MAP)) {0}), ((re_hash_map_desc_t) {0}))
+
+#define re_index_map_free(MAP) _re_index_map_free_impl((void **) &(MAP))
+
+#define re_index_map_count(MAP) re_dyn_arr_count((MAP)->base.entries)
+
+// Dense array of re_index_map_count entries with 'key' and 'value' members,
+// in insertion order. Valid until the map is modified.
+#define re_index_map_entries(MAP) ((__typeof__((MAP)->entry_type)) (MAP)->base.entries)
+
+#define re_index_map_set(MAP, KEY, VALUE) ({ \
+        re_index_map_init_default(MAP); \
+        _re_index_map_key_t(MAP) temp_key = (KEY); \
+        _re_index_map_value_t(MAP) temp_value = (VALUE); \
+        b8_t new_entry; \
+        u32_t index = _re_index_map_insert_impl(&(MAP)->base, &temp_key, &new_entry); \
+        re_index_map_entries(MAP)[index].value = temp_value; \
+    })
+
+#define re_index_map_get(MAP, KEY) ({ \
+        re_index_map_init_default(MAP); \
+        _re_index_map_key_t(MAP) temp_key = (KEY); \
+        u32_t index = _re_index_map_find_impl(&(MAP)->base, &temp_key); \
+        _re_index_map_entry_t(MAP) *entry = (MAP)->base.null_entry; \
+        if (index != U32_MAX) { \
+            entry = &re_index_map_entries(MAP)[index]; \
+        } \
+        entry->value; \
+    })
+
+// Returns a pointer to the value of KEY or NULL. Valid until the map is
+// modified.
+#define re_index_map_get_ptr(MAP, KEY) ({ \
+        re_index_map_init_default(MAP); \
+        _re_index_map_key_t(MAP) temp_key = (KEY); \
+        u32_t index = _re_index_map_find_impl(&(MAP)->base, &temp_key); \
+        _re_index_map_value_t(MAP) *result = NULL; \
+        if (index != U32_MAX) { \
+            result = &re_index_map_entries(MAP)[index].value; \
+        } \
+        result; \
+    })
+
+// Returns the position of KEY in the entries or U32_MAX.
+#define re_index_map_get_index(MAP, KEY) ({ \
+        re_index_map_init_default(MAP); \
+        _re_index_map_key_t(MAP) temp_key = (KEY); \
+        _re_index_map_find_impl(&(MAP)->base, &temp_key); \
+    })
+
+#define re_index_map_has(MAP, KEY) ({ \
+        b8_t result = false; \
+        if ((MAP) != NULL) { \
+            _re_index_map_key_t(MAP) temp_key = (KEY); \
+            result = _re_index_map_find_impl(&(MAP)->base, &temp_key) != U32_MAX; \
+        } \
+        result; \
+    })
+
+// Removes KEY by moving the last entry into its place.
+#define re_index_map_remove(MAP, KEY) ({ \
+        re_index_map_init_default(MAP); \
+        _re_index_map_key_t(MAP) temp_key = (KEY); \
+        _re_index_map_entry_t(MAP) result; \
+        if (!_re_index_map_remove_impl(&(MAP)->base, &temp_key, &result)) { \
+            result = *(_re_index_map_entry_t(MAP) *) (MAP)->base.null_entry; \
+        } \
+        result.value; \
+    })
+
+RE_API void _re_index_map_init_impl(void **map, u32_t map_size, u32_t key_size, u32_t value_size, u32_t value_offset, u32_t entry_size, const void *null_entry, re_hash_map_desc_t desc);
+RE_API void _re_index_map_free_impl(void **map);
+// Returns the entry index of key or U32_MAX.
+RE_API u32_t _re_index_map_find_impl(const _re_index_map_t *map, const void *key);
+// Returns the entry index of key, appending an entry with the key and the
+// null value if it isn't in the map.
+RE_API u32_t _re_index_map_insert_impl(_re_index_map_t *map, const void *key, b8_t *new_entry);
+// Copies the removed entry to entry if it isn't NULL.
+RE_API b8_t _re_index_map_remove_impl(_re_index_map_t *map, const void *key, void *entry);
 
 /*=========================*/
 // Logger
@@ -936,6 +1713,9 @@ struct re_pool_handle_t {
 // Create a pool.
 RE_API re_pool_t *re_pool_create(u32_t object_size, re_arena_t *arena);
 RE_API u32_t re_pool_get_count(const re_pool_t *pool);
+// Allocator handing out pool objects. Allocations can't be bigger than the
+// pool's object size.
+RE_API re_allocator_t re_pool_allocator(re_pool_t *pool);
 
 // Retrieve a new handle.
 RE_API re_pool_handle_t re_pool_new(re_pool_t *pool);
@@ -1030,6 +1810,7 @@ typedef void (*re_func_ptr_t)(void);
 // Loads a dynamic library.
 // Returns NULL if it fails.
 RE_API re_lib_t *re_lib_load(const char *filepath, re_lib_mode_t mode);
+RE_API re_lib_t *re_lib_load_alloc(const char *filepath, re_lib_mode_t mode, re_allocator_t allocator);
 // Unloads a dynamic library.
 RE_API void re_lib_unload(re_lib_t *lib);
 // Retrieves a function using 'name' from dynamic library.
@@ -1053,12 +1834,15 @@ RE_API re_thread_t re_thread_create(re_thread_func_t func, void *arg);
 RE_API void re_thread_destroy(re_thread_t thread);
 // Pauses current thread until 'thread' is finished.
 RE_API void re_thread_wait(re_thread_t thread);
+// Gives up the rest of the current thread's time slice.
+RE_API void re_thread_yield(void);
 
 // Mutexes
 typedef struct re_mutex_t re_mutex_t;
 
 // Creates a mutex.
 RE_API re_mutex_t *re_mutex_create(void);
+RE_API re_mutex_t *re_mutex_create_alloc(re_allocator_t allocator);
 // Frees all memory and handles to mutex.
 RE_API void re_mutex_destroy(re_mutex_t *mutex);
 // Locks mutex.
@@ -1072,19 +1856,47 @@ RE_API void re_mutex_unlock(re_mutex_t *mutex);
 
 // Gets time since last re_os_get_time call.
 RE_API f32_t re_os_get_time(void);
+// Gets a monotonic timestamp in nanoseconds, for measuring short intervals.
+RE_API u64_t re_os_get_time_ns(void);
 // Gets number of usable cores.
 RE_API u32_t re_os_get_processor_count(void);
 // Gets size of a memory page.
 RE_API u32_t re_os_get_page_size(void);
+// Gets size of the default huge page.
+RE_API u32_t re_os_get_huge_page_size(void);
 
 /*=========================*/
 // Memory
 /*=========================*/
 
+typedef enum {
+    RE_OS_HUGE_PAGES_NONE,
+    // Transparent huge pages requested through madvise.
+    RE_OS_HUGE_PAGES_TRANSPARENT,
+    // Explicit huge pages taken from the hugetlbfs pool.
+    RE_OS_HUGE_PAGES_EXPLICIT
+} re_os_huge_pages_t;
+
+// Reserves 'size' bytes of address space without committing them.
+// Returns NULL if the range can't be reserved.
 RE_API void *re_os_mem_reserve(usize_t size);
+// Reserves 'size' bytes aligned to the huge page size.
+// 'size' must be a multiple of the huge page size.
+// Returns NULL if the pages can't be reserved.
+RE_API void *re_os_mem_reserve_huge(usize_t size, re_os_huge_pages_t huge_pages);
 RE_API void re_os_mem_commit(void *ptr, usize_t size);
+// Decommits memory and returns the physical pages to the system immediately.
 RE_API void re_os_mem_decommit(void *ptr, usize_t size);
+// Decommits memory, the system reclaims the physical pages once it runs low on memory.
+// Cheaper than re_os_mem_decommit, at the cost of resident size shrinking later.
+RE_API void re_os_mem_decommit_lazy(void *ptr, usize_t size);
 RE_API void re_os_mem_release(void *ptr, usize_t size);
+// Counts bytes within the range that are backed by huge pages.
+RE_API u64_t re_os_mem_huge_page_bytes(void *ptr, usize_t size);
+// Maps a whole file into memory read-only and writes its size to 'size'.
+// Returns NULL if the file can't be opened, is empty or can't be mapped.
+RE_API const void *re_os_file_map(const char *filepath, usize_t *size);
+RE_API void re_os_file_unmap(const void *ptr, usize_t size);
 
 #ifdef RE_UNIT_TESTS
 
@@ -1092,7 +1904,6 @@ RE_API void re_os_mem_release(void *ptr, usize_t size);
 // Unit test
 /*=========================*/
 
-RE_API void re_dyn_arr_unit_test(void);
 RE_API void re_hash_map_unit_test(void);
 
 #endif // RE_UNIT_TESTS
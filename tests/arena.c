@@ -0,0 +1,265 @@
+#include "rebound.h"
+
+static void count_named_arena(const re_arena_stats_t *stats, void *user_data) {
+    if (strcmp(stats->name, "stats test") == 0) {
+        (*(u32_t *) user_data)++;
+    }
+}
+
+static void fill_shared_arena(void *arg) {
+    re_shared_arena_t *arena = arg;
+    for (u32_t i = 0; i < 10000; i++) {
+        u32_t *values = re_shared_arena_push_aligned(arena, sizeof(u32_t) * 16, 64);
+        for (u32_t j = 0; j < 16; j++) {
+            values[j] = i;
+        }
+    }
+}
+
+static void recycle_scratch(void *arg) {
+    re_arena_temp_t scratch = re_arena_scratch_get(NULL, 0);
+    *(re_arena_t **) arg = scratch.arena;
+    re_arena_scratch_release(&scratch);
+    re_arena_scratch_recycle();
+}
+
+void test_arena(void) {
+    {
+        re_arena_t *arena = re_arena_create_desc((re_arena_desc_t) {
+                .capacity = MB(64),
+                .commit_size = KB(64)
+            });
+
+        u8_t *big = re_arena_push(arena, MB(32));
+        big[0] = 1;
+        big[MB(32) - 1] = 1;
+
+        re_arena_pop(arena, MB(32));
+        u8_t *again = re_arena_push_zero(arena, KB(100));
+        RE_ENSURE(again == big, "re_arena_pop failed.");
+        RE_ENSURE(again[KB(100) - 1] == 0, "re_arena_push_zero failed.");
+
+        re_arena_clear(arena);
+        RE_ENSURE(re_arena_push(arena, 1) == big, "re_arena_clear failed.");
+
+        re_arena_destroy(&arena);
+        RE_ENSURE(arena == NULL, "re_arena_destroy failed.");
+
+        re_log_info("re_arena_create_desc passed.");
+    }
+
+    {
+        re_arena_t *arena = re_arena_create(KB(64));
+
+        re_arena_push(arena, 3);
+        f64_t *number = re_arena_push_struct(arena, f64_t);
+        RE_ENSURE(re_ptr_to_usize(number) % _Alignof(f64_t) == 0, "re_arena_push_struct failed.");
+
+        re_arena_push(arena, 1);
+        re_vec4_t *vecs = re_arena_push_array_zero(arena, re_vec4_t, 4);
+        RE_ENSURE(re_ptr_to_usize(vecs) % _Alignof(re_vec4_t) == 0, "re_arena_push_array failed.");
+        RE_ENSURE(vecs[3].w == 0.0f, "re_arena_push_array_zero failed.");
+
+        re_arena_push(arena, 5);
+        void *page = re_arena_push_aligned(arena, 8, 4096);
+        RE_ENSURE(re_ptr_to_usize(page) % 4096 == 0, "re_arena_push_aligned failed.");
+
+        re_arena_destroy(&arena);
+
+        re_log_info("re_arena_push_aligned passed.");
+    }
+
+    {
+        re_arena_t *arena = re_arena_create_desc((re_arena_desc_t) {
+                .capacity = MB(16),
+                .flags = RE_ARENA_FLAG_HUGE_PAGES_EXPLICIT
+            });
+        RE_ENSURE(re_ptr_to_usize(arena) % re_os_get_huge_page_size() == 0, "Huge page arena not aligned.");
+
+        u8_t *data = re_arena_push(arena, MB(4));
+        memset(data, 1, MB(4));
+        u64_t huge_page_bytes = re_arena_get_huge_page_bytes(arena);
+        RE_ENSURE(huge_page_bytes <= MB(6), "re_arena_get_huge_page_bytes counted more than was committed.");
+
+        re_arena_destroy(&arena);
+
+        // Without a hugetlbfs pool the arena falls back to transparent huge
+        // pages, which the kernel only hands out when they're enabled.
+        char mode[128] = {0};
+        FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+        if (fp != NULL) {
+            if (fgets(mode, sizeof(mode), fp) == NULL) {
+                mode[0] = '\0';
+            }
+            fclose(fp);
+        }
+        if (strstr(mode, "[always]") != NULL || strstr(mode, "[madvise]") != NULL) {
+            RE_ENSURE(huge_page_bytes > 0, "re_arena_get_huge_page_bytes found no huge pages.");
+            re_log_info("re_arena huge pages passed.");
+        } else {
+            re_log_info("re_arena huge pages skipped, transparent huge pages are disabled.");
+        }
+    }
+
+    {
+        re_arena_t *arena = re_arena_create_desc((re_arena_desc_t) {
+                .capacity = MB(16),
+                .commit_size = KB(64),
+                .retain_size = MB(1)
+            });
+
+        u8_t *data = re_arena_push(arena, MB(4));
+        memset(data, 0xff, MB(4));
+        re_arena_clear(arena);
+        data = re_arena_push(arena, MB(4));
+
+        // Retained pages stay warm, decommitted pages come back zeroed.
+        RE_ENSURE(data[KB(512)] == 0xff, "Arena retain size not kept.");
+        RE_ENSURE(data[MB(3)] == 0, "Arena memory not decommitted.");
+
+        re_arena_destroy(&arena);
+
+        re_log_info("re_arena retain size passed.");
+    }
+
+    {
+        re_arena_t *arena = re_arena_create_desc((re_arena_desc_t) {
+                .capacity = MB(16),
+                .commit_size = KB(64),
+                .flags = RE_ARENA_FLAG_STATS,
+                .name = "stats test"
+            });
+
+        u64_t start = re_arena_get_pos(arena);
+        re_arena_push(arena, KB(100));
+        re_arena_push(arena, KB(200));
+        re_arena_clear(arena);
+        re_arena_push(arena, 16);
+
+        re_arena_stats_t stats = re_arena_get_stats(arena);
+        RE_ENSURE(stats.push_count == 3, "re_arena_get_stats push count failed.");
+        RE_ENSURE(stats.push_bytes == KB(300) + 16, "re_arena_get_stats push bytes failed.");
+        RE_ENSURE(stats.peak_position == start + KB(300), "re_arena_get_stats peak position failed.");
+        RE_ENSURE(stats.peak_commited >= stats.commited, "re_arena_get_stats peak commited failed.");
+        RE_ENSURE(stats.decommit_count == 1, "re_arena_get_stats decommit count failed.");
+
+        u32_t found = 0;
+        re_arena_registry_iter(count_named_arena, &found);
+        RE_ENSURE(found == 1, "re_arena_registry_iter failed.");
+
+        re_arena_destroy(&arena);
+
+        found = 0;
+        re_arena_registry_iter(count_named_arena, &found);
+        RE_ENSURE(found == 0, "Destroyed arena still registered.");
+
+        re_log_info("re_arena_get_stats passed.");
+    }
+
+    {
+        re_arena_t *arena = re_arena_create_desc((re_arena_desc_t) {
+                .capacity = KB(64),
+                .flags = RE_ARENA_FLAG_CHAINED
+            });
+
+        u8_t *first = re_arena_push(arena, KB(48));
+        first[0] = 1;
+        re_arena_temp_t temp = re_arena_temp_start(arena);
+
+        // Doesn't fit in the first block.
+        u8_t *second = re_arena_push(arena, KB(32));
+        second[0] = 2;
+        u64_t index = re_arena_get_pos(arena) - KB(32);
+        u8_t *big = re_arena_push(arena, MB(1));
+        big[MB(1) - 1] = 3;
+        RE_ENSURE(re_arena_get_index(index, arena) == second, "re_arena_get_index failed.");
+        RE_ENSURE(*(u8_t *) re_arena_get_index(re_arena_get_pos(arena) - 1, arena) == 3, "re_arena_get_index failed.");
+
+        re_arena_temp_end(&temp);
+        RE_ENSURE(re_arena_get_pos(arena) == temp.position, "re_arena_temp_end across blocks failed.");
+        RE_ENSURE(*(u8_t *) re_arena_get_index(temp.position - KB(48), arena) == 1, "re_arena_temp_end across blocks failed.");
+
+        re_arena_push(arena, KB(32));
+        re_arena_pop(arena, KB(32) + KB(16));
+        RE_ENSURE(re_arena_get_pos(arena) == temp.position - KB(16), "re_arena_pop across blocks failed.");
+
+        re_arena_destroy(&arena);
+
+        // Restoring a position at the very end of a full block must drop the
+        // block after it rather than push over that block's header.
+        arena = re_arena_create_desc((re_arena_desc_t) {
+                .capacity = KB(64),
+                .flags = RE_ARENA_FLAG_CHAINED
+            });
+        // Fill the first block byte by byte until a push lands in the next
+        // one, then take that byte back.
+        u64_t block_end = re_arena_get_pos(arena);
+        while (true) {
+            re_arena_push(arena, 1);
+            if (re_arena_get_pos(arena) != block_end + 1) {
+                break;
+            }
+            block_end++;
+        }
+        re_arena_pop(arena, 1);
+        RE_ENSURE(re_arena_get_pos(arena) == block_end, "re_arena_pop of a new block failed.");
+        temp = re_arena_temp_start(arena);
+        re_arena_push(arena, 100);
+        re_arena_temp_end(&temp);
+        RE_ENSURE(re_arena_get_pos(arena) == temp.position, "re_arena_temp_end at a block end failed.");
+
+        u8_t *after = re_arena_push(arena, 64);
+        memset(after, 0xff, 64);
+        RE_ENSURE(re_arena_get_pos(arena) > temp.position && re_arena_get_pos(arena) <= temp.position + KB(4),
+                "re_arena_temp_end at a block end corrupted the next block.");
+        RE_ENSURE(re_arena_get_index(re_arena_get_pos(arena) - 64, arena) == after, "re_arena_temp_end at a block end corrupted the next block.");
+
+        re_arena_destroy(&arena);
+
+        re_log_info("re_arena chained passed.");
+    }
+
+    {
+        re_shared_arena_t *arena = re_shared_arena_create(MB(64));
+        u64_t start = re_shared_arena_get_pos(arena);
+
+        re_thread_t threads[4];
+        for (u32_t i = 0; i < re_arr_len(threads); i++) {
+            threads[i] = re_thread_create(fill_shared_arena, arena);
+        }
+        for (u32_t i = 0; i < re_arr_len(threads); i++) {
+            re_thread_wait(threads[i]);
+        }
+
+        // Every 64 byte block must have been written by a single push.
+        RE_ENSURE(re_shared_arena_get_pos(arena) - start <= 4 * 10000 * 64 + 64, "re_shared_arena_push_aligned failed.");
+        u32_t *values = (u32_t *) re_align_up(re_ptr_to_usize(arena) + start, 64);
+        for (u32_t i = 0; i < 4 * 10000; i++) {
+            for (u32_t j = 1; j < 16; j++) {
+                RE_ENSURE(values[i * 16 + j] == values[i * 16], "re_shared_arena pushes overlap.");
+            }
+        }
+
+        re_shared_arena_destroy(&arena);
+
+        re_log_info("re_shared_arena passed.");
+    }
+
+    {
+        re_arena_temp_t first = re_arena_scratch_get(NULL, 0);
+        re_arena_temp_t second = re_arena_scratch_get(&first.arena, 1);
+        RE_ENSURE(first.arena != NULL && second.arena != NULL, "re_arena_scratch_get failed.");
+        RE_ENSURE(first.arena != second.arena, "re_arena_scratch_get returned a conflicting arena.");
+        re_arena_scratch_release(&second);
+        re_arena_scratch_release(&first);
+
+        re_arena_t *recycled[2] = {0};
+        for (u32_t i = 0; i < 2; i++) {
+            re_thread_t thread = re_thread_create(recycle_scratch, &recycled[i]);
+            re_thread_wait(thread);
+        }
+        RE_ENSURE(recycled[0] == recycled[1], "re_arena_scratch_recycle failed.");
+
+        re_log_info("re_arena_scratch passed.");
+    }
+}
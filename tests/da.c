@@ -6,199 +6,266 @@ void test_da(void) {
     {
         i32_t expected[] = {5, 4, 3, 2, 1, 0};
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
+        re_dyn_arr_t(i32_t) da = NULL;
 
         for (u32_t i = 0; i < 6; i++) {
-            re_da_insert(da, i, 0);
+            re_dyn_arr_insert(da, i, 0);
         }
 
-        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_da_insert failed.");
-        RE_ENSURE(re_da_count(da) == 6, "re_da_insert failed.");
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_insert failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 6, "re_dyn_arr_insert failed.");
 
-        re_da_destroy(da);
+        re_dyn_arr_free(da);
 
-        re_log_info("re_da_insert passed.");
+        re_log_info("re_dyn_arr_insert passed.");
     }
 
     {
         i32_t expected[] = {5, 0, 1, 2, 3, 4};
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
+        re_dyn_arr_t(i32_t) da = NULL;
 
         for (u32_t i = 0; i < 6; i++) {
-            re_da_insert_fast(da, i, 0);
+            re_dyn_arr_insert_fast(da, i, 0);
         }
 
-        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_da_insert_fast failed.");
-        RE_ENSURE(re_da_count(da) == 6, "re_da_insert_fast failed.");
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_insert_fast failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 6, "re_dyn_arr_insert_fast failed.");
 
-        re_da_destroy(da);
+        re_dyn_arr_free(da);
 
-        re_log_info("re_da_insert_fast passed.");
+        re_log_info("re_dyn_arr_insert_fast passed.");
     }
 
     {
         i32_t expected[] = {0, 1, 2, 3, 4, 5};
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
+        re_dyn_arr_t(i32_t) da = NULL;
 
         for (u32_t i = 0; i < 6; i++) {
-            re_da_push(da, i);
+            re_dyn_arr_push(da, i);
         }
 
-        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_da_push failed.");
-        RE_ENSURE(re_da_count(da) == 6, "re_da_push failed.");
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_push failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 6, "re_dyn_arr_push failed.");
 
-        re_da_destroy(da);
+        re_dyn_arr_free(da);
 
-        re_log_info("re_da_push passed.");
+        re_log_info("re_dyn_arr_push passed.");
     }
 
     {
         i32_t expected[] = {2, 3, 4, 5, 6, 7};
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
+        re_dyn_arr_t(i32_t) da = NULL;
 
-        re_da_insert_arr(da, &arr[re_arr_len(arr) / 2], re_arr_len(arr) / 2, 0);
-        re_da_insert_arr(da, arr, re_arr_len(arr) / 2, 0);
+        re_dyn_arr_insert_arr(da, &arr[re_arr_len(arr) / 2], re_arr_len(arr) / 2, 0);
+        re_dyn_arr_insert_arr(da, arr, re_arr_len(arr) / 2, 0);
 
-        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_da_insert_arr failed.");
-        RE_ENSURE(re_da_count(da) == 6, "re_da_insert_arr failed.");
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_insert_arr failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 6, "re_dyn_arr_insert_arr failed.");
 
-        re_da_destroy(da);
+        re_dyn_arr_free(da);
 
-        re_log_info("re_da_insert_arr passed.");
+        re_log_info("re_dyn_arr_insert_arr passed.");
+    }
+
+    {
+        i32_t expected[] = {2, 5, 6, 7, 3, 4};
+
+        re_dyn_arr_t(i32_t) da = NULL;
+
+        re_dyn_arr_insert_arr(da, arr, re_arr_len(arr) / 2, 0);
+        re_dyn_arr_insert_arr(da, &arr[re_arr_len(arr) / 2], re_arr_len(arr) / 2, 1);
+
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_insert_arr in the middle failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 6, "re_dyn_arr_insert_arr in the middle failed.");
+
+        re_dyn_arr_free(da);
+
+        re_log_info("re_dyn_arr_insert_arr in the middle passed.");
+    }
+
+    {
+        i32_t expected[] = {0, 0, 0, 0};
+
+        re_dyn_arr_t(i32_t) da = NULL;
+        re_dyn_arr_reserve(da, 4);
+
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_reserve failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 4, "re_dyn_arr_reserve failed.");
+
+        re_dyn_arr_free(da);
+
+        re_log_info("re_dyn_arr_reserve passed.");
     }
 
     {
         i32_t expected[] = {2, 3, 4, 5, 6, 7};
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
+        re_dyn_arr_t(i32_t) da = NULL;
 
-        re_da_push_arr(da, arr, re_arr_len(arr) / 2);
-        re_da_push_arr(da, &arr[re_arr_len(arr) / 2], re_arr_len(arr) / 2);
+        re_dyn_arr_push_arr(da, arr, re_arr_len(arr) / 2);
+        re_dyn_arr_push_arr(da, &arr[re_arr_len(arr) / 2], re_arr_len(arr) / 2);
 
-        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_da_push_arr failed.");
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_push_arr failed.");
 
-        re_da_destroy(da);
+        re_dyn_arr_free(da);
 
-        re_log_info("re_da_push_arr passed.");
+        re_log_info("re_dyn_arr_push_arr passed.");
     }
 
     {
         i32_t expected[] = {2, 4, 5, 6, 7};
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
-        re_da_push_arr(da, arr, re_arr_len(arr));
+        re_dyn_arr_t(i32_t) da = NULL;
+        re_dyn_arr_push_arr(da, arr, re_arr_len(arr));
 
-        i32_t out = 0;
-        re_da_remove(da, 1, &out);
+        i32_t out = re_dyn_arr_remove(da, 1);
 
-        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_da_remove failed.");
-        RE_ENSURE(out == 3, "re_da_remove failed.");
-        RE_ENSURE(re_da_count(da) == 5, "re_da_remove_fast failed.");
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_remove failed.");
+        RE_ENSURE(out == 3, "re_dyn_arr_remove failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 5, "re_dyn_arr_remove failed.");
 
-        re_da_destroy(da);
+        re_dyn_arr_free(da);
 
-        re_log_info("re_da_remove passed.");
+        re_log_info("re_dyn_arr_remove passed.");
     }
 
     {
         i32_t expected[] = {2, 7, 4, 5, 6};
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
-        re_da_push_arr(da, arr, re_arr_len(arr));
+        re_dyn_arr_t(i32_t) da = NULL;
+        re_dyn_arr_push_arr(da, arr, re_arr_len(arr));
 
-        i32_t out = 0;
-        re_da_remove_fast(da, 1, &out);
+        i32_t out = re_dyn_arr_remove_fast(da, 1);
 
-        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_da_remove_fast failed.");
-        RE_ENSURE(out == 3, "re_da_remove_fast failed.");
-        RE_ENSURE(re_da_count(da) == 5, "re_da_remove_fast failed.");
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_remove_fast failed.");
+        RE_ENSURE(out == 3, "re_dyn_arr_remove_fast failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 5, "re_dyn_arr_remove_fast failed.");
 
-        re_da_destroy(da);
+        re_dyn_arr_free(da);
 
-        re_log_info("re_da_remove_fast passed.");
+        re_log_info("re_dyn_arr_remove_fast passed.");
     }
 
     {
         i32_t expected[] = {2, 3, 4, 5, 6};
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
-        re_da_push_arr(da, arr, re_arr_len(arr));
+        re_dyn_arr_t(i32_t) da = NULL;
+        re_dyn_arr_push_arr(da, arr, re_arr_len(arr));
 
-        i32_t out = 0;
-        re_da_pop(da, &out);
+        i32_t out = re_dyn_arr_pop(da);
 
-        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_da_pop failed.");
-        RE_ENSURE(out == 7, "re_da_pop failed.");
-        RE_ENSURE(re_da_count(da) == 5, "re_da_pop failed.");
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_pop failed.");
+        RE_ENSURE(out == 7, "re_dyn_arr_pop failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 5, "re_dyn_arr_pop failed.");
 
-        re_da_destroy(da);
+        re_dyn_arr_free(da);
 
-        re_log_info("re_da_pop passed.");
+        re_log_info("re_dyn_arr_pop passed.");
     }
 
     {
         i32_t expected[] = {5, 6, 7};
         i32_t expected_out[] = {2, 3, 4};
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
-        re_da_push_arr(da, arr, re_arr_len(arr));
+        re_dyn_arr_t(i32_t) da = NULL;
+        re_dyn_arr_push_arr(da, arr, re_arr_len(arr));
 
         i32_t out[3] = {0};
-        re_da_remove_arr(da, 3, 0, &out);
+        re_dyn_arr_remove_arr(da, 3, 0, out);
 
-        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_da_remove_arr failed.");
-        RE_ENSURE(memcmp(out, expected_out, sizeof(expected_out)) == 0, "re_da_remove_arr failed.");
-        RE_ENSURE(re_da_count(da) == 3, "re_da_remove_arr failed.");
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_remove_arr failed.");
+        RE_ENSURE(memcmp(out, expected_out, sizeof(expected_out)) == 0, "re_dyn_arr_remove_arr failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 3, "re_dyn_arr_remove_arr failed.");
 
-        re_da_destroy(da);
+        re_dyn_arr_free(da);
 
-        re_log_info("re_da_remove_arr passed.");
+        re_log_info("re_dyn_arr_remove_arr passed.");
     }
 
     {
         i32_t expected[] = {2, 3, 4};
         i32_t expected_out[] = {5, 6, 7};
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
-        re_da_push_arr(da, arr, re_arr_len(arr));
+        re_dyn_arr_t(i32_t) da = NULL;
+        re_dyn_arr_push_arr(da, arr, re_arr_len(arr));
 
         i32_t out[3] = {0};
-        re_da_pop_arr(da, 3, &out);
+        re_dyn_arr_pop_arr(da, 3, out);
 
-        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_da_pop_arr failed.");
-        RE_ENSURE(memcmp(out, expected_out, sizeof(expected_out)) == 0, "re_da_pop_arr failed.");
-        RE_ENSURE(re_da_count(da) == 3, "re_da_pop_arr failed.");
+        RE_ENSURE(memcmp(da, expected, sizeof(expected)) == 0, "re_dyn_arr_pop_arr failed.");
+        RE_ENSURE(memcmp(out, expected_out, sizeof(expected_out)) == 0, "re_dyn_arr_pop_arr failed.");
+        RE_ENSURE(re_dyn_arr_count(da) == 3, "re_dyn_arr_pop_arr failed.");
 
-        re_da_destroy(da);
+        re_dyn_arr_free(da);
 
-        re_log_info("re_da_pop_arr passed.");
+        re_log_info("re_dyn_arr_pop_arr passed.");
     }
 
     {
         i32_t expected = 7;
 
-        re_da_t(i32_t) da = NULL;
-        re_da_create(da);
-        re_da_push_arr(da, arr, re_arr_len(arr));
+        re_dyn_arr_t(i32_t) da = NULL;
+        re_dyn_arr_push_arr(da, arr, re_arr_len(arr));
+
+        i32_t result = re_dyn_arr_last(da);
+        RE_ENSURE(result == expected, "re_dyn_arr_last failed.");
+
+        re_dyn_arr_free(da);
 
-        i32_t result = re_da_last(da);
-        RE_ENSURE(result == expected, "re_da_last failed.");
+        re_log_info("re_dyn_arr_last passed.");
+    }
+
+    {
+        re_dyn_arr_t(i32_t) da = NULL;
+        for (u32_t i = 0; i < 1000; i++) {
+            re_dyn_arr_push(da, i);
+        }
+
+        RE_ENSURE(re_dyn_arr_capacity(da) >= 1000, "re_dyn_arr_capacity too small.");
+        re_dyn_arr_shrink_to_fit(da);
+        RE_ENSURE(re_dyn_arr_capacity(da) == 1000, "re_dyn_arr_shrink_to_fit kept extra capacity.");
+        for (u32_t i = 0; i < 1000; i++) {
+            RE_ENSURE(da[i] == (i32_t) i, "re_dyn_arr_shrink_to_fit lost elements.");
+        }
+
+        // Pushing into a full array grows it again.
+        re_dyn_arr_push(da, 1000);
+        RE_ENSURE(re_dyn_arr_capacity(da) > 1000, "re_dyn_arr_push didn't grow the array.");
+        RE_ENSURE(da[1000] == 1000, "re_dyn_arr_push after shrinking failed.");
+
+        re_dyn_arr_pop_arr(da, 1001, NULL);
+        re_dyn_arr_shrink_to_fit(da);
+        RE_ENSURE(re_dyn_arr_capacity(da) == 0, "re_dyn_arr_shrink_to_fit kept extra capacity.");
+        re_dyn_arr_push(da, 7);
+        RE_ENSURE(re_dyn_arr_count(da) == 1 && da[0] == 7, "re_dyn_arr_push after shrinking failed.");
+
+        re_dyn_arr_free(da);
+
+        re_log_info("re_dyn_arr_shrink_to_fit passed.");
+    }
+
+    {
+        re_arena_t *arena = re_arena_create(MB(1));
+        re_dyn_arr_t(i32_t) da = NULL;
+        re_dyn_arr_new_arena(da, arena);
+        i32_t *first = da;
+
+        for (u32_t i = 0; i < 1000; i++) {
+            re_dyn_arr_push(da, i);
+        }
+
+        RE_ENSURE(re_dyn_arr_count(da) == 1000, "re_dyn_arr_new_arena failed.");
+        // Only the array lives in the arena, so growing extends it in place.
+        RE_ENSURE(da == first, "re_dyn_arr_new_arena didn't grow in place.");
+        for (u32_t i = 0; i < 1000; i++) {
+            RE_ENSURE(da[i] == (i32_t) i, "re_dyn_arr_new_arena failed.");
+        }
 
-        re_da_destroy(da);
+        re_arena_destroy(&arena);
 
-        re_log_info("re_da_last passed.");
+        re_log_info("re_dyn_arr_new_arena passed.");
     }
 }
@@ -0,0 +1,493 @@
+#include "rebound.h"
+
+// Runs the same random workload against a map and a flat reference array.
+static void test_engine(re_hash_map_engine_t engine, u32_t flags, const char *name) {
+    enum { KEY_RANGE = 4096, OPERATIONS = 200000 };
+
+    re_hash_map_t(u32_t, u64_t) map = NULL;
+    re_hash_map_init_desc(map, 0, 0, ((re_hash_map_desc_t) {.engine = engine, .flags = flags}));
+
+    u64_t *reference = re_malloc(KEY_RANGE * sizeof(u64_t));
+    memset(reference, 0, KEY_RANGE * sizeof(u64_t));
+    u32_t reference_count = 0;
+
+    b8_t migrated = false;
+    u64_t state = 0x9e3779b97f4a7c15ull;
+    for (u32_t i = 0; i < OPERATIONS; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        u32_t key = (state >> 33) % KEY_RANGE;
+        switch ((state >> 20) % 3) {
+            case 0:
+            case 1:
+                if (reference[key] == 0) {
+                    reference_count++;
+                }
+                reference[key] = i + 1;
+                re_hash_map_set(map, key, i + 1);
+                break;
+            case 2: {
+                u64_t removed = re_hash_map_remove(map, key);
+                RE_ENSURE(removed == reference[key], "%s: re_hash_map_remove returned %llu instead of %llu.", name, removed, reference[key]);
+                if (reference[key] != 0) {
+                    reference_count--;
+                }
+                reference[key] = 0;
+            } break;
+        }
+        RE_ENSURE(re_hash_map_count(map) == reference_count, "%s: count doesn't match.", name);
+        migrated |= map->base.old_table.buckets != NULL;
+    }
+    if ((flags & RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE) && engine != RE_HASH_MAP_ENGINE_ROBIN_HOOD) {
+        RE_ENSURE(migrated, "%s: never resized incrementally.", name);
+    }
+    if (engine == RE_HASH_MAP_ENGINE_ROBIN_HOOD) {
+        RE_ENSURE(map->base.table.tombstone_count == 0, "%s: removal left tombstones.", name);
+    }
+
+    for (u32_t key = 0; key < KEY_RANGE; key++) {
+        RE_ENSURE(re_hash_map_get(map, key) == reference[key], "%s: re_hash_map_get doesn't match.", name);
+        RE_ENSURE(re_hash_map_has(map, key) == (reference[key] != 0), "%s: re_hash_map_has doesn't match.", name);
+    }
+
+    u32_t iterated = 0;
+    for (re_hash_map_iter_t iter = re_hash_map_iter_get(map);
+            re_hash_map_iter_valid(iter);
+            iter = re_hash_map_iter_next(map, iter)) {
+        u32_t key = re_hash_map_get_index_key(map, iter);
+        RE_ENSURE(re_hash_map_get_index_value(map, iter) == reference[key], "%s: iteration doesn't match.", name);
+        iterated++;
+    }
+    RE_ENSURE(iterated == reference_count, "%s: iterated %u of %u entries.", name, iterated, reference_count);
+
+    re_hash_map_free(map);
+    re_free(reference);
+
+    re_log_info("re_hash_map %s passed.", name);
+}
+
+static void test_reserve(void) {
+    enum { COUNT = 10000 };
+
+    re_hash_map_t(u32_t, u32_t) map = NULL;
+    re_hash_map_init_capacity(map, 100);
+    u32_t capacity = map->base.table.capacity;
+    for (u32_t i = 0; i < 100; i++) {
+        re_hash_map_set(map, i, i);
+    }
+    RE_ENSURE(map->base.table.capacity == capacity, "re_hash_map_init_capacity didn't make room.");
+
+    re_hash_map_reserve(map, COUNT);
+    capacity = map->base.table.capacity;
+    RE_ENSURE(COUNT < capacity * _RE_HASH_MAP_MAX_LOAD, "re_hash_map_reserve didn't make room.");
+
+    u32_t *keys = re_malloc(COUNT * sizeof(u32_t));
+    u32_t *values = re_malloc(COUNT * sizeof(u32_t));
+    for (u32_t i = 0; i < COUNT; i++) {
+        keys[i] = i * 7;
+        values[i] = i;
+    }
+    re_hash_map_set_arr(map, keys, values, COUNT);
+    RE_ENSURE(map->base.table.capacity == capacity, "re_hash_map_set_arr grew a reserved map.");
+
+    // Keys below 100 that are multiples of 7 were already in the map.
+    RE_ENSURE(re_hash_map_count(map) == COUNT + 100 - 15, "re_hash_map_set_arr count doesn't match.");
+    for (u32_t i = 0; i < COUNT; i++) {
+        RE_ENSURE(re_hash_map_get(map, i * 7) == i, "re_hash_map_set_arr value doesn't match.");
+    }
+
+    re_free(keys);
+    re_free(values);
+    re_hash_map_free(map);
+
+    re_log_info("re_hash_map_reserve passed.");
+}
+
+static void test_str_map(void) {
+    re_arena_t *arena = re_arena_create(MB(1));
+
+    re_str_map_t(u32_t) map = NULL;
+    re_str_map_init(map, arena);
+
+    char buffer[16];
+    for (u32_t i = 0; i < 100; i++) {
+        sprintf(buffer, "key %u", i);
+        re_hash_map_set(map, re_str_cstr(buffer), i);
+    }
+    // The map must own its keys since buffer keeps getting overwritten.
+    memset(buffer, 0, sizeof(buffer));
+
+    RE_ENSURE(re_hash_map_count(map) == 100, "re_str_map count doesn't match.");
+    RE_ENSURE(re_hash_map_get(map, re_str_lit("key 42")) == 42, "re_str_map lookup by content failed.");
+    RE_ENSURE(re_hash_map_has(map, re_str_lit("key 4")), "re_str_map lookup by content failed.");
+    RE_ENSURE(!re_hash_map_has(map, re_str_lit("key 100")), "re_str_map found a missing key.");
+
+    // Lookups by borrowed strings don't allocate.
+    u64_t arena_pos = re_arena_get_pos(arena);
+    re_str_t long_key = re_str_lit("key 42 and then some");
+    RE_ENSURE(re_hash_map_get(map, re_str_prefix(long_key, 6)) == 42, "re_str_map lookup by substring failed.");
+    RE_ENSURE(re_arena_get_pos(arena) == arena_pos, "re_str_map lookup allocated.");
+
+    RE_ENSURE(re_hash_map_remove(map, re_str_lit("key 7")) == 7, "re_str_map remove failed.");
+    RE_ENSURE(re_hash_map_count(map) == 99, "re_str_map count doesn't match.");
+
+    re_hash_map_free(map);
+    re_arena_destroy(&arena);
+
+    re_log_info("re_str_map passed.");
+}
+
+static void test_get_ptr(void) {
+    typedef struct {
+        u32_t hits;
+        u8_t payload[256];
+    } counter_t;
+
+    re_hash_map_t(u32_t, counter_t) map = NULL;
+    RE_ENSURE(re_hash_map_get_ptr(map, 1) == NULL, "re_hash_map_get_ptr found a missing key.");
+
+    for (u32_t i = 0; i < 1000; i++) {
+        counter_t *counter = re_hash_map_get_or_insert_ptr(map, i % 10);
+        counter->hits++;
+        counter->payload[i / 10] = 1;
+    }
+    RE_ENSURE(re_hash_map_count(map) == 10, "re_hash_map_get_or_insert_ptr count doesn't match.");
+    for (u32_t key = 0; key < 10; key++) {
+        counter_t *counter = re_hash_map_get_ptr(map, key);
+        RE_ENSURE(counter != NULL && counter->hits == 100, "re_hash_map_get_or_insert_ptr didn't update in place.");
+        RE_ENSURE(counter->payload[99] == 1 && counter->payload[100] == 0, "re_hash_map_get_or_insert_ptr payload doesn't match.");
+    }
+
+    re_hash_map_free(map);
+
+    re_log_info("re_hash_map_get_ptr passed.");
+}
+
+static void test_get_ptr_during_resize(re_hash_map_engine_t engine, const char *name) {
+    re_hash_map_t(u32_t, u32_t) map = NULL;
+    re_hash_map_init_desc(map, 0, 0, ((re_hash_map_desc_t) {.engine = engine, .flags = RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE, .capacity = 1000}));
+
+    u32_t key_count = 1;
+    while (map->base.old_table.buckets == NULL && key_count < 10000) {
+        re_hash_map_set(map, key_count, key_count * 3);
+        key_count++;
+    }
+    RE_ENSURE((map->base.old_table.buckets == NULL) == (engine == RE_HASH_MAP_ENGINE_ROBIN_HOOD),
+            "Only robin hood maps should skip incremental resizing.");
+
+    // Keys still in the old buckets are migrated by the lookups, which must
+    // not move the values found before them.
+    u32_t **values = re_malloc(key_count * sizeof(u32_t *));
+    for (u32_t key = 1; key < key_count; key++) {
+        values[key] = re_hash_map_get_ptr(map, key);
+        RE_ENSURE(values[key] != NULL && *values[key] == key * 3, "re_hash_map_get_ptr failed during a resize.");
+    }
+    for (u32_t key = 1; key < key_count; key++) {
+        RE_ENSURE(*values[key] == key * 3, "re_hash_map_get_ptr pointer moved by a lookup.");
+    }
+    re_free(values);
+
+    re_hash_map_free(map);
+
+    re_log_info("re_hash_map_get_ptr during resize %s passed.", name);
+}
+
+typedef re_shared_hash_map_t(u32_t, u32_t) shared_map_t;
+
+typedef struct {
+    shared_map_t map;
+    u32_t first_key;
+} shared_fill_t;
+
+static void fill_shared_map(void *arg) {
+    shared_fill_t *fill = arg;
+    for (u32_t i = 0; i < 10000; i++) {
+        u32_t key = fill->first_key + i;
+        re_shared_hash_map_set(fill->map, key, key * 2);
+        RE_ENSURE(re_shared_hash_map_get(fill->map, key) == key * 2, "re_shared_hash_map_get failed.");
+        if (i % 2 == 1) {
+            re_shared_hash_map_remove(fill->map, key);
+        }
+    }
+}
+
+static void test_shared_map(void) {
+    shared_map_t map = NULL;
+    re_shared_hash_map_init_default(map);
+
+    shared_fill_t fills[4];
+    re_thread_t threads[4];
+    for (u32_t i = 0; i < re_arr_len(threads); i++) {
+        fills[i] = (shared_fill_t) {map, i * 10000};
+        threads[i] = re_thread_create(fill_shared_map, &fills[i]);
+    }
+    for (u32_t i = 0; i < re_arr_len(threads); i++) {
+        re_thread_wait(threads[i]);
+        re_thread_destroy(threads[i]);
+    }
+
+    RE_ENSURE(re_shared_hash_map_count(map) == 4 * 5000, "re_shared_hash_map count doesn't match.");
+    for (u32_t key = 0; key < 4 * 10000; key++) {
+        b8_t expected = key % 2 == 0;
+        RE_ENSURE(re_shared_hash_map_has(map, key) == expected, "re_shared_hash_map_has doesn't match.");
+        RE_ENSURE(re_shared_hash_map_get(map, key) == (expected ? key * 2 : 0), "re_shared_hash_map_get doesn't match.");
+    }
+
+    re_shared_hash_map_free(map);
+    RE_ENSURE(map == NULL, "re_shared_hash_map_free failed.");
+
+    re_log_info("re_shared_hash_map passed.");
+}
+
+// Overwrites SIZE bytes at OFFSET of a snapshot header, checks the snapshot
+// is refused and puts the original bytes back.
+static void check_corrupt_snapshot(const char *filepath, u32_t offset, u64_t value, u32_t size, const char *field) {
+    u8_t original[8];
+    FILE *fp = fopen(filepath, "r+b");
+    RE_ENSURE(fp != NULL, "Couldn't open %s.", filepath);
+    RE_ENSURE(fseek(fp, offset, SEEK_SET) == 0 && fread(original, size, 1, fp) == 1, "Couldn't read the snapshot header.");
+    RE_ENSURE(fseek(fp, offset, SEEK_SET) == 0 && fwrite(&value, size, 1, fp) == 1, "Couldn't corrupt the snapshot header.");
+    fclose(fp);
+
+    re_hash_map_t(u64_t, u32_t) loaded = NULL;
+    RE_ENSURE(!re_hash_map_load_default(loaded, filepath), "re_hash_map_load accepted a corrupt %s.", field);
+    RE_ENSURE(loaded == NULL, "re_hash_map_load left a map behind on failure.");
+
+    fp = fopen(filepath, "r+b");
+    RE_ENSURE(fp != NULL, "Couldn't open %s.", filepath);
+    RE_ENSURE(fseek(fp, offset, SEEK_SET) == 0 && fwrite(original, size, 1, fp) == 1, "Couldn't restore the snapshot header.");
+    fclose(fp);
+}
+
+static void test_snapshot(re_hash_map_engine_t engine, u32_t flags, const char *name) {
+    const char *filepath = "/tmp/rebound_test_hash_map.snapshot";
+
+    re_hash_map_t(u64_t, u32_t) map = NULL;
+    re_hash_map_init_desc(map, 0, U32_MAX, ((re_hash_map_desc_t) {.engine = engine, .flags = flags}));
+    for (u64_t key = 0; key < 20000; key++) {
+        re_hash_map_set(map, key * 7, (u32_t) key);
+    }
+    for (u64_t key = 0; key < 20000; key += 5) {
+        re_hash_map_remove(map, key * 7);
+    }
+    RE_ENSURE(re_hash_map_save(map, filepath), "re_hash_map_save failed.");
+
+    re_hash_map_t(u64_t, u32_t) loaded = NULL;
+    RE_ENSURE(re_hash_map_load(loaded, filepath, 0, U32_MAX, ((re_hash_map_desc_t) {0})), "re_hash_map_load failed.");
+    RE_ENSURE(loaded->base.engine == engine, "re_hash_map_load lost the engine.");
+    RE_ENSURE(re_hash_map_count(loaded) == re_hash_map_count(map), "re_hash_map_load count doesn't match.");
+    for (u64_t key = 0; key < 20000 * 7; key++) {
+        RE_ENSURE(re_hash_map_get(loaded, key) == re_hash_map_get(map, key), "re_hash_map_load value doesn't match.");
+    }
+    u32_t visited = 0;
+    for (u32_t i = re_hash_map_iter_get(loaded); re_hash_map_iter_valid(i); i = re_hash_map_iter_next(loaded, i)) {
+        RE_ENSURE(re_hash_map_has(map, re_hash_map_get_index_key(loaded, i)), "re_hash_map_load iteration found a wrong key.");
+        visited++;
+    }
+    RE_ENSURE(visited == re_hash_map_count(map), "re_hash_map_load iteration count doesn't match.");
+    re_hash_map_free(loaded);
+    RE_ENSURE(loaded == NULL, "re_hash_map_free of a snapshot failed.");
+
+    // The layout is checked against the types of the map loading it.
+    re_hash_map_t(u64_t, u64_t) wrong = NULL;
+    RE_ENSURE(!re_hash_map_load_default(wrong, filepath), "re_hash_map_load accepted the wrong value type.");
+    RE_ENSURE(wrong == NULL, "re_hash_map_load left a map behind on failure.");
+
+    // Header field offsets, the layout is private to rebound.c.
+    u32_t capacity = map->base.table.capacity;
+    check_corrupt_snapshot(filepath, 12, RE_HASH_MAP_ENGINE_COUNT, 4, "engine");
+    check_corrupt_snapshot(filepath, 16, 1u << 7, 4, "flags");
+    check_corrupt_snapshot(filepath, 36, 0, 4, "capacity");
+    check_corrupt_snapshot(filepath, 36, capacity - 1, 4, "capacity");
+    check_corrupt_snapshot(filepath, 40, capacity, 4, "count");
+    check_corrupt_snapshot(filepath, 44, U32_MAX, 4, "tombstone count");
+    check_corrupt_snapshot(filepath, 56, 65, 8, "buckets offset");
+    check_corrupt_snapshot(filepath, 56, U64_MAX - 63, 8, "buckets offset");
+    check_corrupt_snapshot(filepath, 64, U64_MAX, 8, "buckets size");
+    if (engine == RE_HASH_MAP_ENGINE_SWISS) {
+        check_corrupt_snapshot(filepath, 72, U64_MAX, 8, "ctrl offset");
+    }
+    check_corrupt_snapshot(filepath, 80, capacity + 15, 8, "ctrl size");
+    RE_ENSURE(re_hash_map_load_default(loaded, filepath), "re_hash_map_load failed after restoring the header.");
+    re_hash_map_free(loaded);
+
+    re_hash_map_free(map);
+    remove(filepath);
+    RE_ENSURE(!re_hash_map_load_default(wrong, filepath), "re_hash_map_load accepted a missing file.");
+
+    re_log_info("re_hash_map snapshot (%s) passed.", name);
+}
+
+static u64_t constant_hash(const void *data, u64_t size) {
+    (void) data;
+    (void) size;
+    return 42;
+}
+
+static void test_frozen_map(void) {
+    static const u32_t counts[] = {0, 1, 2, 100, 100000};
+    for (u32_t c = 0; c < re_arr_len(counts); c++) {
+        re_hash_map_t(u64_t, u32_t) map = NULL;
+        re_hash_map_init_desc(map, 0, U32_MAX, ((re_hash_map_desc_t) {.engine = (re_hash_map_engine_t) (c % 3)}));
+        for (u32_t i = 0; i < counts[c]; i++) {
+            re_hash_map_set(map, (u64_t) i * 3, i);
+        }
+
+        re_frozen_map_t(u64_t, u32_t) frozen = NULL;
+        RE_ENSURE(re_hash_map_freeze(map, frozen), "re_hash_map_freeze failed.");
+        RE_ENSURE(re_frozen_map_count(frozen) == counts[c], "re_frozen_map count doesn't match.");
+        for (u64_t key = 0; key < (u64_t) counts[c] * 3 + 3; key++) {
+            RE_ENSURE(re_frozen_map_get(frozen, key) == re_hash_map_get(map, key), "re_frozen_map_get doesn't match.");
+            RE_ENSURE(re_frozen_map_has(frozen, key) == (key % 3 == 0 && key < (u64_t) counts[c] * 3), "re_frozen_map_has doesn't match.");
+        }
+        for (u32_t i = 0; i < re_frozen_map_count(frozen); i++) {
+            RE_ENSURE(re_hash_map_get(map, re_frozen_map_keys(frozen)[i]) == re_frozen_map_values(frozen)[i], "re_frozen_map arrays don't match.");
+        }
+        RE_ENSURE(re_frozen_map_get_ptr(frozen, 1) == NULL, "re_frozen_map_get_ptr found a missing key.");
+
+        re_frozen_map_free(frozen);
+        RE_ENSURE(frozen == NULL, "re_frozen_map_free failed.");
+        re_hash_map_free(map);
+    }
+
+    // Keys with the same full hash can't be told apart by a displacement.
+    re_hash_map_t(u32_t, u32_t) colliding = NULL;
+    re_hash_map_init(colliding, 0, 0, constant_hash, NULL);
+    re_hash_map_set(colliding, 1, 1);
+    re_hash_map_set(colliding, 2, 2);
+    re_frozen_map_t(u32_t, u32_t) frozen = NULL;
+    RE_ENSURE(!re_hash_map_freeze(colliding, frozen), "re_hash_map_freeze separated equal hashes.");
+    RE_ENSURE(frozen == NULL, "re_hash_map_freeze left a map behind on failure.");
+    re_hash_map_free(colliding);
+
+    re_log_info("re_frozen_map passed.");
+}
+
+static void test_hash_set(re_hash_map_engine_t engine, const char *name) {
+    re_hash_set_t(u32_t) evens = NULL;
+    re_hash_set_t(u32_t) thirds = NULL;
+    re_hash_set_init_desc(evens, U32_MAX, ((re_hash_map_desc_t) {.engine = engine}));
+    re_hash_set_init_desc(thirds, U32_MAX, ((re_hash_map_desc_t) {.engine = engine}));
+
+    re_hash_map_t(u32_t, b8_t) emulated = NULL;
+    re_hash_map_init_default(emulated);
+    RE_ENSURE(evens->base.bucket_size < emulated->base.bucket_size, "re_hash_set buckets aren't smaller than the map ones.");
+    re_hash_map_free(emulated);
+
+    for (u32_t i = 0; i < 10000; i += 2) {
+        RE_ENSURE(re_hash_set_insert(evens, i), "re_hash_set_insert didn't insert a new key.");
+    }
+    for (u32_t i = 0; i < 10000; i += 3) {
+        re_hash_set_insert(thirds, i);
+    }
+    RE_ENSURE(!re_hash_set_insert(evens, 0), "re_hash_set_insert inserted a key twice.");
+    RE_ENSURE(re_hash_set_count(evens) == 5000, "re_hash_set count doesn't match.");
+    RE_ENSURE(re_hash_set_remove(evens, 4), "re_hash_set_remove didn't find the key.");
+    RE_ENSURE(!re_hash_set_remove(evens, 5), "re_hash_set_remove found a missing key.");
+    re_hash_set_insert(evens, 4);
+
+    u32_t visited = 0;
+    for (u32_t i = re_hash_set_iter_get(evens); re_hash_set_iter_valid(i); i = re_hash_set_iter_next(evens, i)) {
+        RE_ENSURE(re_hash_set_get_index_key(evens, i) % 2 == 0, "re_hash_set iteration found a wrong key.");
+        visited++;
+    }
+    RE_ENSURE(visited == 5000, "re_hash_set iteration count doesn't match.");
+
+    re_hash_set_t(u32_t) both = NULL;
+    re_hash_set_union(both, evens);
+    re_hash_set_intersect(both, thirds);
+    re_hash_set_union(evens, thirds);
+    for (u32_t i = 0; i < 10000; i++) {
+        RE_ENSURE(re_hash_set_has(both, i) == (i % 6 == 0), "re_hash_set_intersect doesn't match.");
+        RE_ENSURE(re_hash_set_has(evens, i) == (i % 2 == 0 || i % 3 == 0), "re_hash_set_union doesn't match.");
+    }
+    RE_ENSURE(re_hash_set_count(both) == 1667, "re_hash_set_intersect count doesn't match.");
+    RE_ENSURE(re_hash_set_count(evens) == 6667, "re_hash_set_union count doesn't match.");
+
+    re_hash_set_free(evens);
+    re_hash_set_free(thirds);
+    re_hash_set_free(both);
+    RE_ENSURE(evens == NULL, "re_hash_set_free failed.");
+
+    re_log_info("re_hash_set (%s) passed.", name);
+}
+
+static void test_index_map(void) {
+    re_index_map_t(u32_t, u32_t) map = NULL;
+    re_hash_map_t(u32_t, u32_t) reference = NULL;
+
+    for (u32_t i = 0; i < 10000; i++) {
+        re_index_map_set(map, i, i * 3);
+        re_hash_map_set(reference, i, i * 3);
+    }
+    RE_ENSURE(re_index_map_count(map) == 10000, "re_index_map count doesn't match.");
+    for (u32_t i = 0; i < re_index_map_count(map); i++) {
+        RE_ENSURE(re_index_map_entries(map)[i].key == i, "re_index_map isn't in insertion order.");
+    }
+
+    re_index_map_set(map, 5, 7);
+    re_hash_map_set(reference, 5, 7);
+    RE_ENSURE(re_index_map_entries(map)[5].value == 7, "re_index_map overwrite moved the entry.");
+
+    // Removing moves the last entry into the hole.
+    RE_ENSURE(re_index_map_remove(map, 0) == 0, "re_index_map_remove returned the wrong value.");
+    re_hash_map_remove(reference, 0);
+    RE_ENSURE(re_index_map_entries(map)[0].key == 9999, "re_index_map_remove didn't move the last entry.");
+    RE_ENSURE(re_index_map_get_index(map, 9999) == 0, "re_index_map lost track of the moved entry.");
+
+    u64_t state = 42;
+    for (u32_t i = 0; i < 100000; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        u32_t key = (state >> 33) % 20000;
+        if (state & (1ull << 62)) {
+            re_index_map_set(map, key, i);
+            re_hash_map_set(reference, key, i);
+        } else {
+            RE_ENSURE(re_index_map_remove(map, key) == re_hash_map_remove(reference, key), "re_index_map_remove doesn't match.");
+        }
+    }
+
+    RE_ENSURE(re_index_map_count(map) == re_hash_map_count(reference), "re_index_map count doesn't match.");
+    for (u32_t i = 0; i < re_index_map_count(map); i++) {
+        u32_t key = re_index_map_entries(map)[i].key;
+        RE_ENSURE(re_index_map_get_index(map, key) == i, "re_index_map index doesn't match.");
+        RE_ENSURE(re_index_map_entries(map)[i].value == re_hash_map_get(reference, key), "re_index_map value doesn't match.");
+    }
+    for (u32_t key = 0; key < 20000; key++) {
+        RE_ENSURE(re_index_map_has(map, key) == re_hash_map_has(reference, key), "re_index_map_has doesn't match.");
+        RE_ENSURE(re_index_map_get(map, key) == re_hash_map_get(reference, key), "re_index_map_get doesn't match.");
+    }
+    RE_ENSURE(re_index_map_get_ptr(map, 20000) == NULL, "re_index_map_get_ptr found a missing key.");
+
+    re_index_map_free(map);
+    re_hash_map_free(reference);
+    RE_ENSURE(map == NULL, "re_index_map_free failed.");
+
+    re_log_info("re_index_map passed.");
+}
+
+void test_ht(void) {
+    test_engine(RE_HASH_MAP_ENGINE_LINEAR, 0, "linear");
+    test_engine(RE_HASH_MAP_ENGINE_SWISS, 0, "swiss");
+    test_engine(RE_HASH_MAP_ENGINE_ROBIN_HOOD, 0, "robin hood");
+    test_engine(RE_HASH_MAP_ENGINE_LINEAR, RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE, "incremental linear");
+    test_engine(RE_HASH_MAP_ENGINE_SWISS, RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE, "incremental swiss");
+    test_engine(RE_HASH_MAP_ENGINE_ROBIN_HOOD, RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE, "incremental robin hood");
+    test_engine(RE_HASH_MAP_ENGINE_LINEAR, RE_HASH_MAP_FLAG_SOA, "soa linear");
+    test_engine(RE_HASH_MAP_ENGINE_SWISS, RE_HASH_MAP_FLAG_SOA, "soa swiss");
+    test_engine(RE_HASH_MAP_ENGINE_ROBIN_HOOD, RE_HASH_MAP_FLAG_SOA | RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE, "soa incremental robin hood");
+    test_reserve();
+    test_str_map();
+    test_get_ptr();
+    test_get_ptr_during_resize(RE_HASH_MAP_ENGINE_LINEAR, "linear");
+    test_get_ptr_during_resize(RE_HASH_MAP_ENGINE_SWISS, "swiss");
+    test_get_ptr_during_resize(RE_HASH_MAP_ENGINE_ROBIN_HOOD, "robin hood");
+    test_shared_map();
+    test_snapshot(RE_HASH_MAP_ENGINE_LINEAR, 0, "linear");
+    test_snapshot(RE_HASH_MAP_ENGINE_SWISS, 0, "swiss");
+    test_snapshot(RE_HASH_MAP_ENGINE_ROBIN_HOOD, RE_HASH_MAP_FLAG_SOA | RE_HASH_MAP_FLAG_INCREMENTAL_RESIZE, "soa robin hood");
+    test_hash_set(RE_HASH_MAP_ENGINE_LINEAR, "linear");
+    test_hash_set(RE_HASH_MAP_ENGINE_SWISS, "swiss");
+    test_hash_set(RE_HASH_MAP_ENGINE_ROBIN_HOOD, "robin hood");
+    test_index_map();
+    test_frozen_map();
+}
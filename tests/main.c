@@ -1,5 +1,6 @@
 #include "rebound.h"
 
+extern void test_arena(void);
 extern void test_da(void);
 extern void test_ht(void);
 extern void test_pool(void);
@@ -8,9 +9,15 @@ extern void test_str(void);
 i32_t main(void) {
     re_init();
 
+    re_log_info("----- ARENA -----");
+    test_arena();
+
     re_log_info("----- DYNAMIC ARRAY -----");
     test_da();
 
+    re_log_info("----- HASH MAP -----");
+    test_ht();
+
     re_log_info("----- POOL -----");
     test_pool();
 
@@ -27,5 +27,18 @@ void test_pool(void) {
     RE_ENSURE(count == 8, "re_pool_iter failed");
     re_log_info("re_pool_iter passed");
 
+    {
+        re_pool_t *alloc_pool = re_pool_create(sizeof(u64_t), arena);
+        re_allocator_t allocator = re_pool_allocator(alloc_pool);
+        u64_t *a = re_allocator_alloc(allocator, sizeof(u64_t));
+        u64_t *b = re_allocator_alloc(allocator, sizeof(u64_t));
+        RE_ENSURE(a != b && re_pool_get_count(alloc_pool) == 2, "re_pool_allocator alloc failed");
+        *a = 1;
+        *b = 2;
+        re_allocator_free(allocator, a, sizeof(u64_t));
+        RE_ENSURE(re_pool_get_count(alloc_pool) == 1 && *b == 2, "re_pool_allocator free failed");
+        re_log_info("re_pool_allocator passed");
+    }
+
     re_arena_destroy(&arena);
 }